@@ -0,0 +1,59 @@
+// *****************************************************************************
+/*!
+  \file      src/changelog.cpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac log of changes to the set of hashes announced to peers
+*/
+// *****************************************************************************
+
+#include <random>
+
+#include "changelog.hpp"
+
+using piac::ChangeLog;
+
+ChangeLog::ChangeLog( std::size_t capacity ) :
+  m_capacity( capacity ? capacity : 1 ),
+  m_epoch( 0 ),
+  m_seq( 0 ),
+  m_changes()
+// *****************************************************************************
+//  Constructor: empty log with a new epoch
+//! \param[in] capacity Maximum number of changes kept
+// *****************************************************************************
+{
+  std::random_device rd;
+  std::mt19937_64 gen( (static_cast< std::uint64_t >( rd() ) << 32) ^ rd() );
+  while (m_epoch == 0) m_epoch = gen();
+}
+
+void
+ChangeLog::append( const Hash256& hash, bool added )
+// *****************************************************************************
+//  Append change, dropping the oldest if full
+//! \param[in] hash Hash added or removed
+//! \param[in] added True if added, false if removed
+// *****************************************************************************
+{
+  if (m_changes.size() == m_capacity) m_changes.pop_front();
+  m_changes.push_back( { ++m_seq, added, hash } );
+}
+
+bool
+ChangeLog::since( std::uint64_t seq, std::vector< Change >& out ) const
+// *****************************************************************************
+//  Changes after a sequence number
+//! \param[in] seq Sequence number of last change already known
+//! \param[in,out] out Changes after seq appended to, oldest first
+//! \return False if some changes after seq are no longer kept, in which case
+//!   nothing is appended
+// *****************************************************************************
+{
+  if (seq >= m_seq) return true;
+  auto oldest = m_changes.empty() ? m_seq + 1 : m_changes.front().seq;
+  if (seq + 1 < oldest) return false;
+  auto first = m_changes.begin() + static_cast< long >( seq + 1 - oldest );
+  out.insert( out.end(), first, m_changes.end() );
+  return true;
+}
@@ -0,0 +1,65 @@
+// *****************************************************************************
+/*!
+  \file      src/changelog.hpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac log of changes to the set of hashes announced to peers
+*/
+// *****************************************************************************
+
+#pragma once
+
+#include <deque>
+
+#include "hash256.hpp"
+
+namespace piac {
+
+//! Default maximum number of changes kept to announce to peers
+const std::size_t DEFAULT_CHANGELOG_SIZE = 100000;
+
+//! Log of hashes added and removed, numbered by increasing sequence numbers
+//! \details Peers are sent the changes since the last sequence number they
+//!   acknowledged. The log keeps a bounded number of the most recent changes:
+//!   a peer that fell behind further than that has to be fully reconciled.
+//!   The epoch identifies the log, it differs each time the daemon starts, so
+//!   a peer can tell that sequence numbers have restarted.
+class ChangeLog {
+  public:
+    //! Hash added or removed
+    struct Change {
+      //! Sequence number of change
+      std::uint64_t seq;
+      //! True if added, false if removed
+      bool added;
+      //! Hash added or removed
+      Hash256 hash;
+    };
+
+    //! Constructor: empty log with a new epoch
+    explicit ChangeLog( std::size_t capacity = DEFAULT_CHANGELOG_SIZE );
+
+    //! Epoch of log
+    std::uint64_t epoch() const { return m_epoch; }
+
+    //! Sequence number of last change, 0: none yet
+    std::uint64_t seq() const { return m_seq; }
+
+    //! Append change, dropping the oldest if full
+    void append( const Hash256& hash, bool added );
+
+    //! Changes after a sequence number, false if some are no longer kept
+    bool since( std::uint64_t seq, std::vector< Change >& out ) const;
+
+  private:
+    //! Maximum number of changes kept
+    std::size_t m_capacity;
+    //! Epoch of log
+    std::uint64_t m_epoch;
+    //! Sequence number of last change
+    std::uint64_t m_seq;
+    //! Changes kept, consecutive sequence numbers, oldest first
+    std::deque< Change > m_changes;
+};
+
+} // piac::
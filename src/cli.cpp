@@ -452,12 +452,25 @@ main( int argc, char **argv )
       "                Send database command to piac daemon. Example db commands:\n"
       "                > db query cat - search for the word 'cat'\n"
       "                > db query race -condition - search for 'race' but not 'condition'\n"
+      "                > db query --offset 50 --limit 50 --fields title,price,hash --json cat\n"
+      "                  - return results 51-100 with only the fields given as JSON\n"
+      "                > db query --sort -price laptop price:0.5..2\n"
+      "                  - search for 'laptop' priced 0.5-2, most expensive first\n"
+      "                > db query --facets category,condition,location,format laptop\n"
+      "                  - also count the most frequent values of fields among matches\n"
       "                > db add json <path-to-json-db-entry>\n"
-      "                > db rm <hash> - remove document\n"
-      "                > db list - list all documents\n"
+      "                > db rm <hash> [<hash> ...] - remove documents\n"
+      "                > db rm file <path> - remove documents whose hashes are in file\n"
+      "                > db list - list all documents, in chunks\n"
+      "                > db list hash --chunk 100 - list all document hashes, 100 at a time\n"
       "                > db list hash - list all document hashes\n"
       "                > db list numdoc - list number of documents\n"
-      "                > db list numusr - list number of users in db\n\n"
+      "                > db list numusr - list number of users in db\n"
+      "                > db list mine - list documents of current user\n"
+      "                > db list authors - list number of documents per user\n"
+      "                > db list cache - show query cache statistics\n"
+      "                > db list stats - show index size, indexing throughput and schema\n"
+      "                > db compact - compact database in the background\n\n"
       "      exit, quit, q\n"
       "                Exit\n\n"
       "      help\n"
@@ -0,0 +1,164 @@
+// *****************************************************************************
+/*!
+  \file      src/compress.cpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac dictionary compression of documents sent to peers
+*/
+// *****************************************************************************
+
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+
+#include "project_config.hpp"
+#include "crypto_util.hpp"
+#include "compress.hpp"
+#include "compress_dict.hpp"
+
+#ifdef HAS_ZSTD
+  #include <zstd.h>
+#endif
+
+namespace piac {
+
+//! Size of the dictionary of content common to documents
+//! \details The dictionary is trained by zstd on generated documents and
+//!   embedded at configure time, see doc/build.md. Changing the dictionary
+//!   changes the capability advertised, peers with different dictionaries do
+//!   not compress.
+static const std::size_t g_dict_size = sizeof(g_dict);
+
+#ifdef HAS_ZSTD
+//! Compression level, the default: documents are small, level matters little
+static const int g_level = 3;
+#endif
+
+static std::size_t
+elapsed_ns( std::chrono::steady_clock::time_point start )
+// *****************************************************************************
+//! Nanoseconds elapsed since a time point
+//! \param[in] start Time point to measure from
+//! \return Nanoseconds elapsed
+// *****************************************************************************
+{
+  return static_cast< std::size_t >(
+    std::chrono::duration_cast< std::chrono::nanoseconds >(
+      std::chrono::steady_clock::now() - start ).count() );
+}
+
+#ifdef HAS_ZSTD
+//! Compression contexts and dictionaries
+struct Compressor::Context {
+  ZSTD_CCtx* cctx = ZSTD_createCCtx();
+  ZSTD_DCtx* dctx = ZSTD_createDCtx();
+  ZSTD_CDict* cdict = ZSTD_createCDict( g_dict, g_dict_size, g_level );
+  ZSTD_DDict* ddict = ZSTD_createDDict( g_dict, g_dict_size );
+  ~Context() {
+    ZSTD_freeDDict( ddict );
+    ZSTD_freeCDict( cdict );
+    ZSTD_freeDCtx( dctx );
+    ZSTD_freeCCtx( cctx );
+  }
+};
+#else
+//! Compression contexts and dictionaries: none without zstd
+struct Compressor::Context {};
+#endif
+
+} // piac::
+
+using piac::Compressor;
+
+Compressor::Compressor() : m_ctx( std::make_unique< Context >() )
+// *****************************************************************************
+//  Constructor: load dictionary
+// *****************************************************************************
+{
+  #ifdef HAS_ZSTD
+  if (m_ctx->cctx && m_ctx->dctx && m_ctx->cdict && m_ctx->ddict) {
+    std::string dict( reinterpret_cast< const char* >( g_dict ), g_dict_size );
+    auto id = hex( sha256( dict ) );
+    m_capability = "zstd:" + id.substr( 0, 16 );
+  }
+  #endif
+}
+
+Compressor::~Compressor() = default;
+
+std::string
+Compressor::compress( const std::string& doc )
+// *****************************************************************************
+//  Compress document if large enough and if it pays off
+//! \param[in] doc Document to compress
+//! \return Compressed document, or the document itself if not compressed
+// *****************************************************************************
+{
+  if (m_capability.empty() || doc.size() < COMPRESS_MIN_BYTES) return doc;
+
+  #ifdef HAS_ZSTD
+  auto start = std::chrono::steady_clock::now();
+  std::string zip( ZSTD_compressBound( doc.size() ), '\0' );
+  auto n = ZSTD_compress_usingCDict( m_ctx->cctx, zip.data(), zip.size(),
+                                     doc.data(), doc.size(), m_ctx->cdict );
+  m_compress_ns += elapsed_ns( start );
+  if (ZSTD_isError( n ) || n >= doc.size()) return doc;
+  zip.resize( n );
+  ++m_compressed;
+  m_raw_bytes += doc.size();
+  m_zip_bytes += n;
+  return zip;
+  #else
+  return doc;
+  #endif
+}
+
+bool
+Compressor::decompress( std::string& doc )
+// *****************************************************************************
+//  Decompress document if compressed
+//! \param[in,out] doc Document, decompressed in place if compressed
+//! \return False if compressed but could not be decompressed
+// *****************************************************************************
+{
+  // uncompressed documents are JSON, never starting with the zstd magic number
+  if (doc.size() < 4 || doc.compare( 0, 4, "\x28\xb5\x2f\xfd", 4 ))
+    return true;
+
+  #ifdef HAS_ZSTD
+  auto start = std::chrono::steady_clock::now();
+  auto size = ZSTD_getFrameContentSize( doc.data(), doc.size() );
+  if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR ||
+      size > COMPRESS_MAX_BYTES) return false;
+  std::string raw( size, '\0' );
+  auto n = ZSTD_decompress_usingDDict( m_ctx->dctx, raw.data(), raw.size(),
+                                       doc.data(), doc.size(), m_ctx->ddict );
+  m_decompress_ns += elapsed_ns( start );
+  if (ZSTD_isError( n ) || n != size) return false;
+  doc = std::move( raw );
+  ++m_decompressed;
+  return true;
+  #else
+  return false;
+  #endif
+}
+
+std::string
+Compressor::stats() const
+// *****************************************************************************
+//  Summary of compression ratio and time spent
+//! \return Summary as a string
+// *****************************************************************************
+{
+  std::stringstream ss;
+  ss << "compressed " << m_compressed << " docs, " << m_raw_bytes << " -> "
+     << m_zip_bytes << " bytes";
+  if (m_zip_bytes) {
+    ss << " (ratio " << std::fixed << std::setprecision(2)
+       << static_cast< double >( m_raw_bytes ) /
+          static_cast< double >( m_zip_bytes ) << ')';
+  }
+  ss << " in " << m_compress_ns / 1000 << " us, decompressed "
+     << m_decompressed << " docs in " << m_decompress_ns / 1000 << " us";
+  return ss.str();
+}
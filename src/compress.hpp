@@ -0,0 +1,71 @@
+// *****************************************************************************
+/*!
+  \file      src/compress.hpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac dictionary compression of documents sent to peers
+*/
+// *****************************************************************************
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+namespace piac {
+
+//! Documents smaller than this many bytes are sent uncompressed
+const std::size_t COMPRESS_MIN_BYTES = 64;
+//! Compressed documents decompressing to more than this many bytes are dropped
+const std::size_t COMPRESS_MAX_BYTES = 1 << 24;
+
+//! Dictionary compression of documents sent to peers
+//! \details Documents are small JSON objects with the same keys and similar
+//!   values, which compress poorly on their own but well with a dictionary of
+//!   their common content shipped with the daemon. Peers advertise the
+//!   dictionary they use by its capability and documents are only compressed
+//!   for peers advertising the same. Compressed documents are zstd frames,
+//!   told apart from uncompressed JSON by their magic number, so a message may
+//!   mix both. Without zstd available at build time the capability is empty
+//!   and nothing is compressed.
+class Compressor {
+  public:
+    //! Constructor: load dictionary
+    explicit Compressor();
+
+    //! Destructor: free compression contexts
+    ~Compressor();
+
+    //! Capability advertised to peers, empty if compression is not available
+    const std::string& capability() const { return m_capability; }
+
+    //! Compress document if large enough and if it pays off
+    std::string compress( const std::string& doc );
+
+    //! Decompress document if compressed
+    bool decompress( std::string& doc );
+
+    //! Summary of compression ratio and time spent
+    std::string stats() const;
+
+  private:
+    //! Compression contexts and dictionaries, defined if zstd is available
+    struct Context;
+    std::unique_ptr< Context > m_ctx;
+    //! Capability advertised to peers
+    std::string m_capability;
+    //! Number of documents compressed
+    std::size_t m_compressed = 0;
+    //! Bytes of documents compressed before compression
+    std::size_t m_raw_bytes = 0;
+    //! Bytes of documents compressed after compression
+    std::size_t m_zip_bytes = 0;
+    //! Nanoseconds spent compressing
+    std::size_t m_compress_ns = 0;
+    //! Number of documents decompressed
+    std::size_t m_decompressed = 0;
+    //! Nanoseconds spent decompressing
+    std::size_t m_decompress_ns = 0;
+};
+
+} // piac::
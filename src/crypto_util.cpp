@@ -7,9 +7,9 @@
 */
 // *****************************************************************************
 
+#include <array>
+
 #include <cryptopp/sha.h>
-#include <cryptopp/files.h>
-#include <cryptopp/hex.h>
 
 #include "crypto_util.hpp"
 
@@ -29,14 +29,37 @@ piac::sha256( const std::string& msg )
 // ****************************************************************************
 {
   using namespace CryptoPP;
+  static thread_local SHA256 hash;
   std::string digest;
-  SHA256 hash;
   hash.Update( (const byte*)msg.data(), msg.size() );
   digest.resize( hash.DigestSize() );
   hash.Final( (byte*)&digest[0] );
   return digest;
 }
 
+std::vector< piac::Hash256 >
+piac::sha256_batch( const std::vector< std::string >& msgs )
+// ****************************************************************************
+//  Compute sha256 hashes of many strings
+//! \param[in] msgs Strings whose hashes to compute
+//! \return Hashes computed, in the order of msgs
+//! \details A single hash object is reused for all strings and the digests
+//!   are written in place without allocating a string per hash. Crypto++
+//!   selects the SHA extensions of the CPU (x86 SHA-NI, ARMv8 SHA2) at
+//!   runtime if available and falls back to portable code otherwise.
+// ****************************************************************************
+{
+  using namespace CryptoPP;
+  static thread_local SHA256 hash;
+  static_assert( SHA256::DIGESTSIZE == Hash256::SIZE );
+  std::vector< Hash256 > digests( msgs.size() );
+  for (std::size_t i = 0; i < msgs.size(); ++i) {
+    hash.Update( (const byte*)msgs[i].data(), msgs[i].size() );
+    hash.Final( digests[i].data() );
+  }
+  return digests;
+}
+
 #if defined(__clang__)
   #pragma clang diagnostic pop
 #endif
@@ -46,12 +69,59 @@ piac::hex( const std::string& digest )
 // ****************************************************************************
 //  Compute hex encoding of a string
 //! \param[in] digest String to encode in hex
-//! \return Hex encoding
+//! \return Hex encoding, upper case
 // ****************************************************************************
 {
-  using namespace CryptoPP;
-  std::string hex;
-  HexEncoder encoder( new StringSink( hex ) );
-  StringSource( digest, true, new Redirector( encoder ) );
+  static const char digits[] = "0123456789ABCDEF";
+  std::string hex( 2 * digest.size(), '\0' );
+  auto o = hex.begin();
+  for (auto c : digest) {
+    auto b = static_cast< unsigned char >( c );
+    *o++ = digits[ b >> 4 ];
+    *o++ = digits[ b & 0xf ];
+  }
   return hex;
 }
+
+namespace piac {
+
+//! Table of values of hex digits indexed by character, -1: not a hex digit
+static const std::array< signed char, 256 > g_unhex = []{
+  std::array< signed char, 256 > t;
+  t.fill( -1 );
+  for (int i = 0; i < 10; ++i) t[ static_cast< std::size_t >( '0' + i ) ] =
+    static_cast< signed char >( i );
+  for (int i = 0; i < 6; ++i) {
+    t[ static_cast< std::size_t >( 'A' + i ) ] =
+      t[ static_cast< std::size_t >( 'a' + i ) ] =
+        static_cast< signed char >( 10 + i );
+  }
+  return t;
+}();
+
+} // piac::
+
+std::string
+piac::unhex( const std::string& encoded )
+// ****************************************************************************
+//  Decode hex encoding of a string
+//! \param[in] encoded Hex-encoded string to decode
+//! \return Decoded string, characters that are not hex digits are ignored
+//!   and so is a trailing odd digit
+// ****************************************************************************
+{
+  std::string decoded;
+  decoded.reserve( encoded.size() / 2 );
+  int hi = -1;
+  for (auto c : encoded) {
+    int v = g_unhex[ static_cast< unsigned char >( c ) ];
+    if (v < 0) continue;
+    if (hi < 0) {
+      hi = v;
+    } else {
+      decoded.push_back( static_cast< char >( (hi << 4) | v ) );
+      hi = -1;
+    }
+  }
+  return decoded;
+}
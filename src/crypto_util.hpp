@@ -10,13 +10,22 @@
 #pragma once
 
 #include <string>
+#include <vector>
+
+#include "hash256.hpp"
 
 namespace piac {
 
 //! Compute sha256 hash of a string
 std::string sha256( const std::string& msg );
 
+//! Compute sha256 hashes of many strings
+std::vector< Hash256 > sha256_batch( const std::vector< std::string >& msgs );
+
 //! Compute hex encoding of a string
 std::string hex( const std::string& digest );
 
+//! Decode hex encoding of a string
+std::string unhex( const std::string& encoded );
+
 } // ::piac
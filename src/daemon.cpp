@@ -21,6 +21,7 @@
 #include "logging_util.hpp"
 #include "daemon_p2p_thread.hpp"
 #include "daemon_db_thread.hpp"
+#include "db.hpp"
 
 [[noreturn]] static void s_signal_handler( int /*signal_value*/ ) {
   MDEBUG( "interrupted" );
@@ -51,6 +52,9 @@ std::mutex g_hashes_mtx;
 std::condition_variable g_hashes_cv;
 bool g_hashes_access = false;
 
+std::mutex g_peers_mtx;
+std::string g_peers_status;
+
 static void
 save_public_key( const std::string& filename, const std::string& public_key )
 // *****************************************************************************
@@ -124,10 +128,38 @@ usage( const std::string& db_name,
        const std::string& logfile,
        const std::string& rpc_server_save_public_key_file,
        int rpc_port,
-       int p2p_port )
+       int p2p_port,
+       std::size_t db_index_threads,
+       std::size_t db_batch_docs,
+       std::size_t db_batch_bytes,
+       std::size_t db_query_cache_entries,
+       std::size_t db_query_cache_bytes,
+       std::size_t db_list_chunk,
+       std::size_t db_query_threads,
+       double db_compact_interval,
+       double db_compact_churn,
+       std::size_t db_group_commit_ms,
+       std::size_t db_group_commit_docs,
+       double db_tombstone_horizon,
+       double p2p_peer_timeout,
+       std::size_t p2p_fanout )
 // *****************************************************************************
 //! Return program usage information
 //! \param[in] db_name Name of database to use to store ads
+//! \param[in] db_index_threads Number of threads to use for bulk indexing
+//! \param[in] db_batch_docs Number of documents to index between commits
+//! \param[in] db_batch_bytes Number of bytes of input to index between commits
+//! \param[in] db_query_cache_entries Maximum number of query results cached
+//! \param[in] db_query_cache_bytes Maximum number of bytes of results cached
+//! \param[in] db_list_chunk Number of items to return per chunk by list cmds
+//! \param[in] db_query_threads Number of threads serving queries and lookups
+//! \param[in] db_compact_interval Seconds between scheduled compactions
+//! \param[in] db_compact_churn Ratio of documents changed triggering compaction
+//! \param[in] db_group_commit_ms Milliseconds writes are coalesced for
+//! \param[in] db_group_commit_docs Maximum number of documents coalesced
+//! \param[in] db_tombstone_horizon Seconds tombstones are kept for
+//! \param[in] p2p_peer_timeout Seconds without hearing from a peer it is dead
+//! \param[in] p2p_fanout Number of peers to forward announcements to
 //! \param[in] rpc_server_save_public_key_file File to save generated public key
 //! \param[in] rpc_port Port to use for client communication
 //! \param[in] p2p_port Port to use for peer-to-peer communication
@@ -139,10 +171,70 @@ usage( const std::string& db_name,
           "OPTIONS\n"
           "  --db <directory>\n"
           "         Use database, default: " + db_name + ".\n\n"
+          "  --db-batch-bytes <size-in-bytes>\n"
+          "         Commit after indexing this many bytes of input when adding "
+                   "documents in bulk,\n"
+          "         default: " + std::to_string( db_batch_bytes ) + ".\n\n"
+          "  --db-compact-churn <ratio>\n"
+          "         Compact database in the background once the number of "
+                   "documents added and\n"
+          "         removed exceeds this ratio of the number of documents, "
+                   "0 disables, default: "
+                   + std::to_string( db_compact_churn ) + ".\n\n"
+          "  --db-compact-interval <seconds>\n"
+          "         Compact database in the background this often if it has "
+                   "changed, 0 disables,\n"
+          "         default: " + std::to_string( db_compact_interval ) +
+                   ".\n\n"
+          "  --db-batch-docs <num>\n"
+          "         Commit after indexing this many documents when adding "
+                   "documents in bulk,\n"
+          "         default: " + std::to_string( db_batch_docs ) + ".\n\n"
+          "  --db-group-commit-docs <num>\n"
+          "         Commit documents received from peers once this many are "
+                   "pending, default: "
+                   + std::to_string( db_group_commit_docs ) + ".\n\n"
+          "  --db-group-commit-ms <milliseconds>\n"
+          "         Coalesce documents received from peers and change "
+                   "notifications for this\n"
+          "         long into a single commit and notification, default: "
+                   + std::to_string( db_group_commit_ms ) + ".\n\n"
+          "  --db-index-threads <num>\n"
+          "         Number of threads to use to index large number of "
+                   "documents in bulk, default: "
+                   + std::to_string( db_index_threads ) + ".\n\n"
+          "  --db-list-chunk <num>\n"
+          "         Number of items to return at a time by list commands, "
+                   "default: " + std::to_string( db_list_chunk ) + ".\n\n"
+          "  --db-query-threads <num>\n"
+          "         Number of threads to serve queries, lists and lookups "
+                   "concurrently with\n"
+          "         adding documents, default: "
+                   + std::to_string( db_query_threads ) + ".\n\n"
+          "  --db-query-cache-bytes <size-in-bytes>\n"
+          "         Maximum number of bytes of query results to cache, "
+                   "default: " + std::to_string( db_query_cache_bytes ) +
+                   ".\n\n"
+          "  --db-query-cache-entries <num>\n"
+          "         Maximum number of query results to cache, 0 disables the "
+                   "cache, default: "
+                   + std::to_string( db_query_cache_entries ) + ".\n\n"
+          "  --db-tombstone-horizon <seconds>\n"
+          "         Keep records of documents deleted by their authors this "
+                   "long to keep peers\n"
+          "         from syncing them back, default: "
+                   + std::to_string( db_tombstone_horizon ) + ".\n\n"
           "  --detach\n"
           "         Run as a daemon in the background.\n\n"
           "  --help\n"
           "         Show help message.\n\n"
+          "  --index-schema <filename.json>\n"
+          "         Load index schema configuring how document fields are "
+                   "indexed from file. If the\n"
+          "         database was indexed with a different schema, it is "
+                   "reindexed on startup.\n"
+          "         Default: all fields prefixed and unprefixed, with "
+                   "positions, weight 1.\n\n"
           "  --log-file <filename.log>\n"
           "         Specify log filename, default: " + logfile + ".\n\n"
           "  --log-level <[0-4]>\n"
@@ -185,6 +277,17 @@ usage( const std::string& db_name,
           "  --p2p-bind-port <port>\n"
           "         Listen on P2P port given, default: "
                   + std::to_string( p2p_port ) + ".\n\n"
+          "  --p2p-fanout <num>\n"
+          "         Stay connected to at most this many peers plus one, "
+                   "forwarding announcements\n"
+          "         of new ads to them, remember a random sample of "
+                   "others, default: "
+                   + std::to_string( p2p_fanout ) + ".\n\n"
+          "  --p2p-peer-timeout <seconds>\n"
+          "         Disconnect from peers not answering heartbeats this long, "
+                   "reconnect with\n"
+          "         exponential backoff, default: "
+                   + std::to_string( p2p_peer_timeout ) + ".\n\n"
           "  --version\n"
           "         Show version information.\n\n";
 }
@@ -211,6 +314,21 @@ main( int argc, char **argv )
   int p2p_port = default_p2p_port;
   bool use_strict_ports = false;
   std::string db_name( "piac.db" );
+  std::size_t db_index_threads = 1;
+  std::size_t db_batch_docs = piac::DEFAULT_BATCH_DOCS;
+  std::size_t db_batch_bytes = piac::DEFAULT_BATCH_BYTES;
+  std::size_t db_query_cache_entries = piac::DEFAULT_QUERY_CACHE_ENTRIES;
+  std::size_t db_query_cache_bytes = piac::DEFAULT_QUERY_CACHE_BYTES;
+  std::size_t db_list_chunk = piac::DEFAULT_LIST_CHUNK;
+  std::size_t db_query_threads = piac::DEFAULT_QUERY_THREADS;
+  std::string index_schema_file;
+  double db_compact_interval = piac::DEFAULT_COMPACT_INTERVAL;
+  double db_compact_churn = piac::DEFAULT_COMPACT_CHURN;
+  std::size_t db_group_commit_ms = piac::DEFAULT_GROUP_COMMIT_MS;
+  std::size_t db_group_commit_docs = piac::DEFAULT_GROUP_COMMIT_DOCS;
+  double db_tombstone_horizon = piac::DEFAULT_TOMBSTONE_HORIZON;
+  double p2p_peer_timeout = piac::DEFAULT_PEER_TIMEOUT;
+  std::size_t p2p_fanout = piac::DEFAULT_FANOUT;
   std::string logfile( piac::daemon_executable() + ".log" );
   std::string log_level( "4" );
   std::size_t max_log_file_size = MAX_LOG_FILE_SIZE;
@@ -244,11 +362,45 @@ main( int argc, char **argv )
   const int ARG_RPC_SERVER_SAVE_PUBLIC_KEY_FILE = 1011;
   const int ARG_P2P_PORT                        = 1012;
   const int ARG_VERSION                         = 1013;
+  const int ARG_DB_INDEX_THREADS                = 1014;
+  const int ARG_DB_BATCH_DOCS                   = 1015;
+  const int ARG_DB_BATCH_BYTES                  = 1016;
+  const int ARG_DB_QUERY_CACHE_ENTRIES          = 1017;
+  const int ARG_DB_QUERY_CACHE_BYTES            = 1018;
+  const int ARG_DB_LIST_CHUNK                   = 1019;
+  const int ARG_INDEX_SCHEMA                    = 1020;
+  const int ARG_DB_COMPACT_INTERVAL             = 1021;
+  const int ARG_DB_COMPACT_CHURN                = 1022;
+  const int ARG_DB_QUERY_THREADS                = 1023;
+  const int ARG_DB_GROUP_COMMIT_MS              = 1024;
+  const int ARG_DB_GROUP_COMMIT_DOCS            = 1025;
+  const int ARG_DB_TOMBSTONE_HORIZON            = 1026;
+  const int ARG_P2P_PEER_TIMEOUT                = 1027;
+  const int ARG_P2P_FANOUT                      = 1028;
   static struct option long_options[] =
     {
       { "db", required_argument, nullptr, ARG_DB },
+      { "db-batch-bytes", required_argument, nullptr, ARG_DB_BATCH_BYTES },
+      { "db-batch-docs", required_argument, nullptr, ARG_DB_BATCH_DOCS },
+      { "db-compact-churn", required_argument, nullptr, ARG_DB_COMPACT_CHURN },
+      { "db-compact-interval", required_argument, nullptr,
+        ARG_DB_COMPACT_INTERVAL },
+      { "db-group-commit-docs", required_argument, nullptr,
+        ARG_DB_GROUP_COMMIT_DOCS },
+      { "db-group-commit-ms", required_argument, nullptr,
+        ARG_DB_GROUP_COMMIT_MS },
+      { "db-index-threads", required_argument, nullptr, ARG_DB_INDEX_THREADS },
+      { "db-list-chunk", required_argument, nullptr, ARG_DB_LIST_CHUNK },
+      { "db-query-cache-bytes", required_argument, nullptr,
+        ARG_DB_QUERY_CACHE_BYTES },
+      { "db-query-cache-entries", required_argument, nullptr,
+        ARG_DB_QUERY_CACHE_ENTRIES },
+      { "db-query-threads", required_argument, nullptr, ARG_DB_QUERY_THREADS },
+      { "db-tombstone-horizon", required_argument, nullptr,
+        ARG_DB_TOMBSTONE_HORIZON },
       { "detach", no_argument, &detach, 1 },
       { "help", no_argument, nullptr, ARG_HELP },
+      { "index-schema", required_argument, nullptr, ARG_INDEX_SCHEMA },
       { "log-file", required_argument, nullptr, ARG_LOG_FILE },
       { "log-level", required_argument, nullptr, ARG_LOG_LEVEL },
       { "max-log-file-size", required_argument, nullptr, ARG_MAX_LOG_FILE_SIZE },
@@ -265,6 +417,8 @@ main( int argc, char **argv )
       { "rpc-server-save-public-key-file", required_argument, nullptr,
         ARG_RPC_SERVER_SAVE_PUBLIC_KEY_FILE },
       { "p2p-bind-port", required_argument, nullptr, ARG_P2P_PORT },
+      { "p2p-fanout", required_argument, nullptr, ARG_P2P_FANOUT },
+      { "p2p-peer-timeout", required_argument, nullptr, ARG_P2P_PEER_TIMEOUT },
       { "version", no_argument, nullptr, ARG_VERSION },
       { nullptr, 0, nullptr, 0 }
     };
@@ -277,13 +431,107 @@ main( int argc, char **argv )
         break;
       }
 
+      case ARG_DB_BATCH_BYTES: {
+        std::stringstream s;
+        s << optarg;
+        s >> db_batch_bytes;
+        break;
+      }
+
+      case ARG_DB_BATCH_DOCS: {
+        std::stringstream s;
+        s << optarg;
+        s >> db_batch_docs;
+        break;
+      }
+
+      case ARG_DB_COMPACT_CHURN: {
+        std::stringstream s;
+        s << optarg;
+        s >> db_compact_churn;
+        break;
+      }
+
+      case ARG_DB_COMPACT_INTERVAL: {
+        std::stringstream s;
+        s << optarg;
+        s >> db_compact_interval;
+        break;
+      }
+
+      case ARG_DB_GROUP_COMMIT_DOCS: {
+        std::stringstream s;
+        s << optarg;
+        s >> db_group_commit_docs;
+        break;
+      }
+
+      case ARG_DB_GROUP_COMMIT_MS: {
+        std::stringstream s;
+        s << optarg;
+        s >> db_group_commit_ms;
+        break;
+      }
+
+      case ARG_DB_INDEX_THREADS: {
+        std::stringstream s;
+        s << optarg;
+        s >> db_index_threads;
+        break;
+      }
+
+      case ARG_DB_LIST_CHUNK: {
+        std::stringstream s;
+        s << optarg;
+        s >> db_list_chunk;
+        break;
+      }
+
+      case ARG_DB_QUERY_CACHE_BYTES: {
+        std::stringstream s;
+        s << optarg;
+        s >> db_query_cache_bytes;
+        break;
+      }
+
+      case ARG_DB_QUERY_CACHE_ENTRIES: {
+        std::stringstream s;
+        s << optarg;
+        s >> db_query_cache_entries;
+        break;
+      }
+
+      case ARG_DB_QUERY_THREADS: {
+        std::stringstream s;
+        s << optarg;
+        s >> db_query_threads;
+        break;
+      }
+
+      case ARG_DB_TOMBSTONE_HORIZON: {
+        std::stringstream s;
+        s << optarg;
+        s >> db_tombstone_horizon;
+        break;
+      }
+
       case ARG_HELP: {
         std::cout << version << "\n\n" <<
           piac::usage( db_name, logfile, rpc_server_save_public_key_file,
-                       rpc_port, p2p_port );
+                       rpc_port, p2p_port, db_index_threads,
+                       db_batch_docs, db_batch_bytes, db_query_cache_entries,
+                       db_query_cache_bytes, db_list_chunk, db_query_threads,
+                       db_compact_interval, db_compact_churn,
+                       db_group_commit_ms, db_group_commit_docs,
+                       db_tombstone_horizon, p2p_peer_timeout, p2p_fanout );
         return EXIT_SUCCESS;
       }
 
+      case ARG_INDEX_SCHEMA: {
+        index_schema_file = optarg;
+        break;
+      }
+
       case ARG_PEER: {
         peers.push_back( optarg );
         break;
@@ -322,6 +570,20 @@ main( int argc, char **argv )
         break;
       }
 
+      case ARG_P2P_FANOUT: {
+        std::stringstream s;
+        s << optarg;
+        s >> p2p_fanout;
+        break;
+      }
+
+      case ARG_P2P_PEER_TIMEOUT: {
+        std::stringstream s;
+        s << optarg;
+        s >> p2p_peer_timeout;
+        break;
+      }
+
       case ARG_LOG_FILE: {
         logfile = optarg;
         break;
@@ -375,7 +637,14 @@ main( int argc, char **argv )
     std::cerr << "Erros during parsing command line\n"
               << "Command line: " + cmdline.str() << '\n'
               << piac::usage( db_name, logfile,rpc_server_save_public_key_file,
-                              rpc_port, p2p_port );
+                              rpc_port, p2p_port, db_index_threads,
+                              db_batch_docs, db_batch_bytes,
+                              db_query_cache_entries, db_query_cache_bytes,
+                              db_list_chunk, db_query_threads,
+                              db_compact_interval, db_compact_churn,
+                              db_group_commit_ms, db_group_commit_docs,
+                              db_tombstone_horizon, p2p_peer_timeout,
+                              p2p_fanout );
     return EXIT_FAILURE;
   }
 
@@ -398,6 +667,18 @@ main( int argc, char **argv )
     return EXIT_FAILURE;
   }
 
+  piac::IndexSchema index_schema;
+  if (not index_schema_file.empty()) {
+    std::ifstream f( index_schema_file );
+    std::stringstream json;
+    json << f.rdbuf();
+    if (not f.good() || not index_schema.deserialize( json.str() )) {
+      std::cerr << "Cannot load index schema from file: "
+                << index_schema_file << '\n';
+      return EXIT_FAILURE;
+    }
+  }
+
   if (detach) {
     // Fork the current process. The parent process continues with a process ID
     // greater than 0.  A process ID lower than 0 indicates a failure in either
@@ -518,19 +799,24 @@ main( int argc, char **argv )
     my_peers.emplace( p, zmqpp::socket( ctx_p2p, zmqpp::socket_type::dealer ) );
 
   // will store db entry hashes
-  std::unordered_set< std::string > my_hashes;
+  piac::HashSet my_hashes;
 
   // start threads
   std::vector< std::thread > threads;
 
   threads.emplace_back( piac::p2p_thread,
     std::ref(ctx_p2p), std::ref(ctx_db), std::ref(my_peers),
-    std::ref(my_hashes), default_p2p_port, p2p_port, use_strict_ports );
+    std::ref(my_hashes), p2p_peer_timeout, p2p_fanout, default_p2p_port,
+    p2p_port, use_strict_ports );
 
   threads.emplace_back( piac::db_thread,
-    std::ref(ctx_db), db_name, rpc_port, use_strict_ports, std::ref(my_peers),
-    std::ref(my_hashes), rpc_secure, std::ref(rpc_server_keys),
-    std::ref(rpc_authorized_clients) );
+    std::ref(ctx_db), db_name, db_index_threads, db_batch_docs,
+    db_batch_bytes, db_query_cache_entries, db_query_cache_bytes,
+    db_list_chunk, db_query_threads, std::cref(index_schema),
+    db_compact_interval, db_compact_churn, db_group_commit_ms,
+    db_group_commit_docs, db_tombstone_horizon, rpc_port, use_strict_ports,
+    std::ref(my_hashes), rpc_secure,
+    std::ref(rpc_server_keys), std::ref(rpc_authorized_clients) );
 
   // wait for all threads to finish
   for (auto& t : threads) t.join();
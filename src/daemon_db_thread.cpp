@@ -9,46 +9,409 @@
 
 #include <mutex>
 #include <condition_variable>
+#include <thread>
+#include <ctime>
 
 #include "db.hpp"
 #include "logging_util.hpp"
 #include "crypto_util.hpp"
+#include "string_util.hpp"
 #include "zmq_util.hpp"
 #include "daemon_db_thread.hpp"
 
+namespace piac {
+
+static std::string
+extract_auth( std::string& cmd )
+// *****************************************************************************
+//! Extract hash of user auth from a client command if any
+//! \param[in,out] cmd Client command, auth removed on return
+//! \return Hash of user auth, empty if none
+// *****************************************************************************
+{
+  std::string user;
+  auto u = cmd.rfind( "AUTH:" );
+  if (u != std::string::npos) {
+    user = cmd.substr( u + 5 );
+    cmd.erase( u - 1 );
+  }
+  return user;
+}
+
+static std::string
+extract_sign( std::string& cmd )
+// *****************************************************************************
+//! Extract tombstones signed by user from a client command if any
+//! \param[in,out] cmd Client command, signatures removed on return
+//! \return Address, time, and signed hashes of tombstones, empty if none
+// *****************************************************************************
+{
+  std::string sign;
+  auto s = cmd.rfind( "SIGN:" );
+  if (s != std::string::npos) {
+    sign = cmd.substr( s + 5 );
+    cmd.erase( s - 1 );
+  }
+  return sign;
+}
+
+static bool
+read_only( const std::string& cmd )
+// *****************************************************************************
+//! Decide if a client command can be served by a read-only query worker
+//! \param[in] cmd Client command
+//! \return True for queries and lists, except those reporting on the writer
+// *****************************************************************************
+{
+  return cmd.rfind( "db query", 0 ) == 0 ||
+         (cmd.rfind( "db list", 0 ) == 0 && cmd.rfind( "db list stats", 0 ));
+}
+
+static bool
+db_get( Database& db, zmqpp::message& msg, zmqpp::message& reply )
+// *****************************************************************************
+//! Look up documents requested by a peer
+//! \param[in,out] db Database to look up documents in
+//! \param[in,out] msg Message with address of peer, id of request, number of
+//!   bytes the peer is willing to receive, and hashes requested
+//! \param[in,out] reply Message with the documents found to send to the peer
+//! \return False if the request is malformed, nothing to send
+//! \details Hashes are looked up in order until the documents would exceed the
+//!   number of bytes granted, at least one is sent. The number of hashes looked
+//!   up is sent back, so the peer can request the rest again.
+// *****************************************************************************
+{
+  std::string addr, id, budget, size;
+  std::size_t num = 0, bytes = 0;
+  if (msg.remaining() >= 4) msg >> addr >> id >> budget >> size;
+  if (not to_number( budget, bytes ) || not to_number( size, num ) ||
+      num == 0 || msg.remaining() < num)
+  {
+    MERROR( "Malformed request of db entries for " << addr );
+    return false;
+  }
+  std::vector< std::string > hashes;
+  while (num-- != 0) {
+    std::string h;
+    msg >> h;
+    hashes.emplace_back( std::move(h) );
+  }
+
+  std::size_t served = 0;
+  auto docs = piac::db_get_docs( db, hashes, bytes, served );
+  MDEBUG( "Looked up " << served << " of " << hashes.size() << " hashes" );
+
+  reply << "PUT" << addr << id << std::to_string( served )
+        << std::to_string( docs.size() );
+  for (const auto& d : docs) reply << d;
+  MDEBUG( "Sending " << docs.size() << " entries" );
+  return true;
+}
+
+static void
+db_send_tombstones( zmqpp::socket& db_p2p,
+                    const std::string& to,
+                    const std::vector< Tombstone >& tombs )
+// *****************************************************************************
+//! Send tombstones to the p2p thread
+//! \param[in,out] db_p2p ZMQ socket of the daemon's p2p thread
+//! \param[in] to Address of peer to pass them on to, "*": all peers, empty:
+//!   none, only to be remembered
+//! \param[in] tombs Tombstones to send
+// *****************************************************************************
+{
+  zmqpp::message note;
+  note << "TOMB" << to << std::to_string( tombs.size() );
+  for (const auto& t : tombs)
+    note << t.hash << t.author << std::to_string( t.time ) << t.address
+         << t.signature;
+  db_p2p.send( note );
+}
+
+[[noreturn]] static void
+db_query_worker( zmqpp::context& ctx, Database& primary, std::size_t id )
+// *****************************************************************************
+//! Entry point to thread serving queries, lists and lookups read-only
+//! \param[in,out] ctx ZMQ context the db thread's inproc sockets are in
+//! \param[in,out] primary Database owned by the db thread to open a view of
+//! \param[in] id Worker id
+//! \details Each worker opens its own read-only view of the database so that
+//!   workers query concurrently with each other and with the db thread writing
+//!   the database. Client requests arrive from the router, lookups from the
+//!   db thread, both fair-queued by the REP socket.
+// *****************************************************************************
+{
+  MLOG_SET_THREAD_NAME( "db-q" + std::to_string( id ) );
+  Database db( primary, Database::View() );
+
+  zmqpp::socket rep( ctx, zmqpp::socket_type::reply );
+  rep.connect( "inproc://db_workers" );
+  rep.connect( "inproc://db_lookups" );
+  MDEBUG( "db query worker " << id << " initialized" );
+
+  while (1) {
+    zmqpp::message msg;
+    rep.receive( msg );
+    std::string cmd;
+    msg >> cmd;
+    try {
+      if (cmd == "GET") {
+        auto reply = db_get( db, msg );
+        rep.send( reply );
+        continue;
+      }
+      auto user = extract_auth( cmd );
+      MDEBUG( "Recv msg " << cmd );
+      if (cmd.rfind( "db query", 0 ) == 0) {
+        cmd.erase( 0, 9 );
+        rep.send( db_query( db, std::move(cmd) ) );
+      } else {
+        cmd.erase( 0, 8 );
+        rep.send( db_list( db, std::move(cmd), user ) );
+      }
+    } catch ( const std::exception& e ) {
+      MERROR( e.what() );
+      rep.send( "db error" );
+    } catch ( const Xapian::Error& e ) {
+      MERROR( e.get_description() );
+      rep.send( "db error" );
+    }
+  }
+}
+
+[[noreturn]] static void
+db_router( zmqpp::socket& frontend,
+           zmqpp::socket& workers,
+           zmqpp::socket& writer )
+// *****************************************************************************
+//! Entry point to thread routing client requests to query workers or writer
+//! \param[in,out] frontend ROUTER socket clients connect to
+//! \param[in,out] workers DEALER socket query workers connect to
+//! \param[in,out] writer DEALER socket connected to the db thread
+//! \details Queries and lists are load-balanced across the query workers,
+//!   everything else, e.g., adding and removing documents, goes to the db
+//!   thread, the only one writing the database. Replies are routed back to
+//!   clients by the envelope ROUTER prepends. Since this thread only moves
+//!   messages, queries are answered even while the db thread is busy indexing.
+// *****************************************************************************
+{
+  MLOG_SET_THREAD_NAME( "db-r" );
+  zmqpp::poller poller;
+  poller.add( frontend );
+  poller.add( workers );
+  poller.add( writer );
+  while (1) {
+    if (poller.poll()) {
+      if (poller.has_input( frontend )) {
+        zmqpp::message m;
+        frontend.receive( m );
+        if (read_only( m.get( m.parts() - 1 ) ))
+          workers.send( m );
+        else
+          writer.send( m );
+      }
+      if (poller.has_input( workers )) {
+        zmqpp::message m;
+        workers.receive( m );
+        frontend.send( m );
+      }
+      if (poller.has_input( writer )) {
+        zmqpp::message m;
+        writer.receive( m );
+        frontend.send( m );
+      }
+    }
+  }
+}
+
+} // piac::
+
 void
-piac::db_update_hashes( const std::string& db_name,
-                        std::unordered_set< std::string >& my_hashes )
+piac::db_update_hashes( Database& db,
+                        HashSet& my_hashes )
 // *****************************************************************************
 //  Update advertisement database hashes
-//! \param[in] db_name The name of the database to query for the hashes
+//! \param[in,out] db Database to query for the hashes
 //! \param[in] my_hashes Set of advertisement database hashes to update
 // *****************************************************************************
 {
-  auto hashes = piac::db_list_hash( db_name, /* inhex = */ false );
+  auto hashes = piac::db_list_hash( db, /* inhex = */ false );
   std::lock_guard lock( g_hashes_mtx );
   g_hashes_access = false;
   my_hashes.clear();
-  for (auto&& h : hashes) my_hashes.insert( std::move(h) );
+  my_hashes.reserve( hashes.size() );
+  for (const auto& h : hashes) my_hashes.insert( h );
   g_hashes_access = true;
   g_hashes_cv.notify_one();
   MDEBUG( "Number of db hashes: " << my_hashes.size() );
 }
 
+void
+piac::db_update_hashes( const std::vector< std::string >& added,
+                        const std::vector< std::string >& removed,
+                        HashSet& my_hashes )
+// *****************************************************************************
+//  Update advertisement database hashes incrementally
+//! \param[in] added Hashes of documents added to the database
+//! \param[in] removed Hashes of documents removed from the database
+//! \param[in] my_hashes Set of advertisement database hashes to update
+// *****************************************************************************
+{
+  std::lock_guard lock( g_hashes_mtx );
+  g_hashes_access = false;
+  for (const auto& h : removed) my_hashes.erase( h );
+  for (const auto& h : added) my_hashes.insert( h );
+  g_hashes_access = true;
+  g_hashes_cv.notify_one();
+  MDEBUG( "Number of db hashes: " << my_hashes.size() << " (+" << added.size()
+          << ", -" << removed.size() << ')' );
+}
+
+void
+piac::GroupCommit::added( const std::vector< std::string >& hashes,
+                          bool committed )
+// *****************************************************************************
+//  Record documents added, committed or left to commit
+//! \param[in] hashes Hashes of documents added
+//! \param[in] committed True if the documents have been committed, which also
+//!   commits all documents pending in the window
+// *****************************************************************************
+{
+  if (hashes.empty()) return;
+  if (empty()) m_since = std::chrono::steady_clock::now();
+  for (const auto& h : hashes) m_pending.insert( h );
+  if (committed) {
+    this->committed();
+    m_added.insert( end(m_added), begin(hashes), end(hashes) );
+  } else {
+    m_uncommitted.insert( end(m_uncommitted), begin(hashes), end(hashes) );
+  }
+}
+
+void
+piac::GroupCommit::committed()
+// *****************************************************************************
+//  Record documents left to commit as committed
+// *****************************************************************************
+{
+  m_added.insert( end(m_added), begin(m_uncommitted), end(m_uncommitted) );
+  m_uncommitted.clear();
+}
+
+void
+piac::GroupCommit::discard()
+// *****************************************************************************
+//  Forget documents left to commit, discarded by a failed write
+//! \details A write failing in an unflushed transaction discards all changes
+//!   not yet committed, so the documents left to commit are not in the
+//!   database and must not be announced nor added to the db hashes.
+// *****************************************************************************
+{
+  for (const auto& h : m_uncommitted) m_pending.erase( h );
+  m_uncommitted.clear();
+}
+
+void
+piac::GroupCommit::removed( const std::vector< std::string >& hashes )
+// *****************************************************************************
+//  Record documents removed and committed
+//! \param[in] hashes Hashes of documents removed
+// *****************************************************************************
+{
+  if (hashes.empty()) return;
+  if (empty()) m_since = std::chrono::steady_clock::now();
+  m_removed.insert( end(m_removed), begin(hashes), end(hashes) );
+  committed();
+}
+
+void
+piac::GroupCommit::buried( const std::vector< Tombstone >& tombs )
+// *****************************************************************************
+//  Record tombstones recorded and committed
+//! \param[in] tombs Tombstones recorded
+// *****************************************************************************
+{
+  if (tombs.empty()) return;
+  if (empty()) m_since = std::chrono::steady_clock::now();
+  m_buried.insert( end(m_buried), begin(tombs), end(tombs) );
+  committed();
+}
+
+bool
+piac::GroupCommit::due() const
+// *****************************************************************************
+//  Decide if the window has closed
+//! \return True if there are changes and either the window has passed since
+//!   the first one or too many documents are left uncommitted
+// *****************************************************************************
+{
+  if (empty()) return false;
+  return m_uncommitted.size() >= m_max_docs ||
+         std::chrono::steady_clock::now() - m_since >= m_window;
+}
+
+void
+piac::GroupCommit::flush( Database& db,
+                          zmqpp::socket& db_p2p,
+                          HashSet& my_hashes )
+// *****************************************************************************
+//  Commit and notify of all changes in the window
+//! \param[in,out] db Database to commit
+//! \param[in,out] db_p2p ZMQ socket of the daemon's p2p thread
+//! \param[in,out] my_hashes Set of this daemon's advertisement database hashes
+//! \details The note to the p2p thread carries the hashes removed and added,
+//!   in the order applied to my_hashes, to be announced to peers. Tombstones
+//!   follow in a separate note, to be passed on to all peers. If committing
+//!   fails, the documents left to commit are kept for the next window.
+// *****************************************************************************
+{
+  if (empty()) return;
+  auto uncommitted = m_uncommitted.size();
+  if (uncommitted) {
+    try {
+      db.commit();
+      committed();
+    } catch ( const Xapian::Error& e ) {
+      MERROR( e.get_description() );
+    }
+  }
+  if (not m_added.empty() || not m_removed.empty()) {
+    db_update_hashes( m_added, m_removed, my_hashes );
+    zmqpp::message note;
+    note << "NEW";
+    note << std::to_string( m_removed.size() );
+    for (const auto& h : m_removed) note << h;
+    note << std::to_string( m_added.size() );
+    for (const auto& h : m_added) note << h;
+    db_p2p.send( note );
+    MDEBUG( "Sent note on " << m_added.size() << " new and "
+            << m_removed.size() << " removed documents, " << uncommitted
+            << " committed" );
+  }
+  if (not m_buried.empty()) {
+    db_send_tombstones( db_p2p, "*", m_buried );
+    MDEBUG( "Sent " << m_buried.size() << " tombstones" );
+  }
+  m_added.clear();
+  m_removed.clear();
+  m_buried.clear();
+  m_pending.clear();
+  for (const auto& h : m_uncommitted) m_pending.insert( h );
+  m_since = std::chrono::steady_clock::now();
+}
+
 void
 piac::db_client_op(
   zmqpp::socket& client,
-  zmqpp::socket& db_p2p,
-  const std::string& db_name,
-  const std::unordered_map< std::string, zmqpp::socket >& my_peers,
-  std::unordered_set< std::string >& my_hashes,
+  GroupCommit& group,
+  Database& db,
+  HashSet& my_hashes,
   zmqpp::message& msg )
 // *****************************************************************************
 //  Perform a database operation for a client
 //! \param[in,out] client ZMQ socket of the client
-//! \param[in,out] db_p2p ZMQ socket of the daemon's p2p thread
-//! \param[in] db_name The name of the database to operate on
-//! \param[in] my_peers List of this daemon's peers (address and socket)
+//! \param[in,out] group Writes coalesced into a single commit and notification
+//! \param[in,out] db Database to operate on
 //! \param[in,out] my_hashes Set of this daemon's advertisement database hashes
 //! \param[in,out] msg Incoming message to answer
 // *****************************************************************************
@@ -57,12 +420,9 @@ piac::db_client_op(
   msg >> cmd;
 
   // extract hash of user auth from cmd if any, remove from cmd (and log)
-  std::string user;
-  auto u = cmd.rfind( "AUTH:" );
-  if (u != std::string::npos) {
-    user = cmd.substr( u + 5 );
-    cmd.erase( u - 1 );
-  }
+  auto user = extract_auth( cmd );
+  // extract tombstones signed by user from cmd if any, remove from cmd
+  auto sign = extract_sign( cmd );
 
   MDEBUG( "Recv msg " << cmd );
 
@@ -81,36 +441,42 @@ piac::db_client_op(
     if (q[0]=='q' && q[1]=='u' && q[2]=='e' && q[3]=='r' && q[4]=='y') {
 
       q.erase( 0, 6 );
-      reply = piac::db_query( db_name, std::move(q) );
+      reply = piac::db_query( db, std::move(q) );
 
     } else if (q[0]=='a' && q[1]=='d' && q[2]=='d') {
 
       q.erase( 0, 4 );
       assert( not user.empty() );
-      reply = piac::db_add( user, db_name, std::move(q), my_hashes );
-      MDEBUG( "Number of documents: " <<piac::get_doccount( db_name ) );
-      db_update_hashes( db_name, my_hashes );
-      zmqpp::message note;
-      note << "NEW";
-      db_p2p.send( note );
-      MDEBUG( "Sent note on new documents" );
+      std::vector< std::string > added;
+      reply = piac::db_add( user, db, std::move(q), added, my_hashes );
+      group.added( added, /* committed = */ true );
 
     } else if (q[0]=='r' && q[1]=='m') {
 
       q.erase( 0, 3 );
       assert( not user.empty() );
-      reply = piac::db_rm( user, db_name, std::move(q), my_hashes );
-      MDEBUG( "Number of documents: " << piac::get_doccount( db_name ) );
-      db_update_hashes( db_name, my_hashes );
-      zmqpp::message note;
-      note << "NEW";
-      db_p2p.send( note );
-      MDEBUG( "Sent note on removed documents" );
+      std::vector< std::string > removed;
+      reply = piac::db_rm( user, db, std::move(q), sign, removed, my_hashes );
+      group.removed( removed );
+      // tombstones recorded with the documents removed, to pass on to peers
+      std::vector< Tombstone > tombs;
+      for (const auto& h : removed) {
+        Tombstone t;
+        if (db.tombstone( h, t )) tombs.push_back( std::move(t) );
+      }
+      group.buried( tombs );
+
+    } else if (q[0]=='c' && q[1]=='o' && q[2]=='m' && q[3]=='p' &&
+               q[4]=='a' && q[5]=='c' && q[6]=='t')
+    {
+
+      reply = db.compact() ? "Compaction started"
+                           : "Compaction already in progress";
 
     } else if (q[0]=='l' && q[1]=='i' && q[2]=='s' && q[3]=='t') {
 
       q.erase( 0, 5 );
-      reply = piac::db_list( db_name, std::move(q) );
+      reply = piac::db_list( db, std::move(q), user );
 
     } else {
 
@@ -121,15 +487,13 @@ piac::db_client_op(
 
   } else if (cmd == "peers") {
 
-    zmqpp::message reply;
-    if (not my_peers.empty()) {
-      std::stringstream peers_list;
-      for (const auto& [addr,sock] : my_peers) peers_list << addr << ' ';
-      reply << peers_list.str();
-    } else {
-      reply << "No peers";
+    // liveness of peers as last published by the p2p thread
+    std::string status;
+    {
+      std::lock_guard lock( g_peers_mtx );
+      status = g_peers_status;
     }
-    client.send( reply );
+    client.send( status.empty() ? std::string( "No peers" ) : status );
 
   } else {
 
@@ -140,15 +504,17 @@ piac::db_client_op(
 }
 
 void
-piac::db_peer_op( const std::string& db_name,
+piac::db_peer_op( Database& db,
                   zmqpp::message& msg,
                   zmqpp::socket& db_p2p,
-                  std::unordered_set< std::string >& my_hashes )
+                  GroupCommit& group,
+                  HashSet& my_hashes )
 // *****************************************************************************
 //  Perform an operation for a peer
-//! \param[in] db_name The name of the database to operate on
+//! \param[in,out] db Database to operate on
 //! \param[in,out] msg Incoming message to answer
 //! \param[in,out] db_p2p ZMQ socket of the daemon's p2p thread
+//! \param[in,out] group Writes coalesced into a single commit and notification
 //! \param[in,out] my_hashes Set of this daemon's advertisement database hashes
 // *****************************************************************************
 {
@@ -158,53 +524,80 @@ piac::db_peer_op( const std::string& db_name,
 
   if (cmd == "GET") {
 
-    std::string addr, size;
-    msg >> addr >> size;
-    std::size_t num = stoul( size );
-    assert( num > 0 );
-    std::vector< std::string > hashes;
-    while (num-- != 0) {
-      std::string h;
-      msg >> h;
-      hashes.emplace_back( std::move(h) );
-    }
-
-    auto docs = piac::db_get_docs( db_name, hashes );
-    MDEBUG( "Looked up " << docs.size() << " hashes" );
-
     zmqpp::message reply;
-    reply << "PUT" << addr << std::to_string( docs.size() );
-    for (const auto& d : docs) reply << d;
-    db_p2p.send( reply );
-    MDEBUG( "Sending " << docs.size() << " entries" );
+    if (db_get( db, msg, reply )) db_p2p.send( reply );
 
   } else if (cmd == "INS") {
 
     std::string size;
-    msg >> size;
-    std::size_t num = stoul( size );
-    assert( num > 0 );
-    std::vector< std::string > docs;
+    std::size_t num = 0;
+    if (msg.remaining() > 0) msg >> size;
+    if (not to_number( size, num ) || msg.remaining() / 2 < num) {
+      MERROR( "Malformed db entries to insert" );
+      return;
+    }
+    std::vector< std::string > hashes, docs;
     while (num-- != 0) {
-      std::string doc;
-      msg >> doc;
-      auto hash = sha256( doc );
-      if (my_hashes.find(hash) == end(my_hashes)) {
-        docs.emplace_back( std::move(doc) );
+      std::string hash, doc;
+      msg >> hash >> doc;
+      // hashed by the p2p thread on receipt, not hashed again
+      Hash256 h( hash );
+      if (my_hashes.contains( h ) || group.pending( h )) continue;
+      // do not insert documents deleted by their author
+      Tombstone t;
+      if (db.tombstone( hash, t )) {
+        Document d;
+        if (d.deserialize( doc ) && d.author() == t.author) {
+          MDEBUG( "Not inserting deleted entry " << hex(hash) );
+          continue;
+        }
       }
+      hashes.emplace_back( std::move(hash) );
+      docs.emplace_back( std::move(doc) );
     }
     if (not docs.empty()) {
-      piac::db_put_docs( db_name, docs );
-      MDEBUG(  "Inserted " << docs.size() << " entries to db" );
-      auto ndoc = piac::get_doccount( db_name );
-      MDEBUG( "Number of documents: " << ndoc );
-      db_update_hashes( db_name, my_hashes );
-      zmqpp::message reply;
-      reply << "NEW";
-      db_p2p.send( reply );
-      MDEBUG( "Sent note on new documents" );
+      // commit and notify once the group-commit window closes
+      std::vector< std::string > added;
+      if (piac::db_put_docs( db, docs, hashes, added, /* commit = */ false )) {
+        MDEBUG(  "Inserted " << added.size() << " entries to db" );
+        group.added( added, /* committed = */ false );
+      } else {
+        // documents left to commit were discarded with the failed insert
+        group.discard();
+      }
     }
 
+  } else if (cmd == "DEL") {
+
+    std::string size;
+    std::size_t num = 0;
+    if (msg.remaining() > 0) msg >> size;
+    if (not to_number( size, num ) || msg.remaining() / 5 < num) {
+      MERROR( "Malformed tombstones" );
+      return;
+    }
+    std::vector< Tombstone > tombs;
+    while (num-- != 0) {
+      Tombstone t;
+      std::string time;
+      msg >> t.hash >> t.author >> time >> t.address >> t.signature;
+      // relayed from peers, skipped if the time is not a number
+      if (to_number( time, t.time )) tombs.push_back( std::move(t) );
+    }
+    std::vector< std::string > removed;
+    auto fresh = piac::db_bury_docs( db, tombs, removed );
+    MDEBUG( "Recorded " << fresh.size() << " of " << tombs.size()
+            << " tombstones, removed " << removed.size() << " entries" );
+    // notify and pass on once the group-commit window closes
+    group.removed( removed );
+    group.buried( fresh );
+
+  } else if (cmd == "TOMBS") {
+
+    auto tombs = db.tombstones();
+    db_send_tombstones( db_p2p, "", tombs );
+    MDEBUG( "Sent " << tombs.size() << " tombstones" );
+
   } else {
 
     MERROR( "unknown cmd" );
@@ -216,10 +609,22 @@ piac::db_peer_op( const std::string& db_name,
 piac::db_thread(
   zmqpp::context& ctx_db,
   const std::string& db_name,
+  std::size_t db_index_threads,
+  std::size_t db_batch_docs,
+  std::size_t db_batch_bytes,
+  std::size_t db_query_cache_entries,
+  std::size_t db_query_cache_bytes,
+  std::size_t db_list_chunk,
+  std::size_t db_query_threads,
+  const IndexSchema& index_schema,
+  double db_compact_interval,
+  double db_compact_churn,
+  std::size_t db_group_commit_ms,
+  std::size_t db_group_commit_docs,
+  double db_tombstone_horizon,
   int rpc_port,
   bool use_strict_ports,
-  const std::unordered_map< std::string, zmqpp::socket >& my_peers,
-  std::unordered_set< std::string >& my_hashes,
+  HashSet& my_hashes,
   int rpc_secure,
   const zmqpp::curve::keypair& rpc_server_keys,
   const std::vector< std::string >& rpc_authorized_clients )
@@ -227,14 +632,31 @@ piac::db_thread(
 //  Entry point to thread to perform database operations
 //! \param[in,out] ctx_db ZMQ context used for communication with the db thread
 //! \param[in] db_name The name of the database to operate on
+//! \param[in] db_index_threads Number of threads to use for bulk indexing
+//! \param[in] db_batch_docs Number of documents to index between commits
+//! \param[in] db_batch_bytes Number of bytes of input to index between commits
+//! \param[in] db_query_cache_entries Maximum number of query results cached
+//! \param[in] db_query_cache_bytes Maximum number of bytes of results cached
+//! \param[in] db_list_chunk Number of items to return per chunk by list cmds
+//! \param[in] db_query_threads Number of threads serving queries and lookups
+//! \param[in] index_schema Index schema configuring how fields are indexed
+//! \param[in] db_compact_interval Seconds between scheduled compactions
+//! \param[in] db_compact_churn Ratio of documents changed triggering compaction
+//! \param[in] db_group_commit_ms Milliseconds writes are coalesced for
+//! \param[in] db_group_commit_docs Maximum number of documents coalesced
+//! \param[in] db_tombstone_horizon Seconds tombstones are kept for
 //! \param[in] rpc_port Port to use for client communication
 //! \param[in] use_strict_ports True to try only the default port
-//! \param[in] my_peers List of this daemon's peers (address and socket)
 //! \param[in,out] my_hashes Set of this daemon's advertisement database hashes
 //! \param[in] rpc_secure Non-zero to use secure client communication
 //! \param[in] rpc_server_keys CurveMQ keypair to use for secure client comm.
 //! \param[in] rpc_authorized_clients Only communicate with these clients if
 //!    secure communication is used to talk to clients
+//! \details This thread owns the writable database: it adds and removes
+//!   documents and inserts those received from peers. Client requests are
+//!   routed by a router thread so that queries and lists are answered by a
+//!   pool of read-only query workers, which also look up documents requested
+//!   by peers, while this thread is busy writing.
 //! \see http://curvezmq.org
 //! \see http://www.evilpaul.org/wp/2017/05/02/authentication-encryption-zeromq
 // *****************************************************************************
@@ -243,12 +665,32 @@ piac::db_thread(
   MINFO( "db thread initialized" );
   MINFO( "Using database: " << db_name );
 
+  // open database, keep handles alive for the lifetime of the thread
+  MINFO( "Index schema: " << index_schema.summary() );
+  Database db( db_name, index_schema );
+  db.index_threads( db_index_threads );
+  MINFO( "Bulk indexing threads: " << db.index_threads() );
+  db.batch_docs( db_batch_docs );
+  db.batch_bytes( db_batch_bytes );
+  MINFO( "Bulk indexing commits every " << db.batch_docs() << " documents or "
+         << db.batch_bytes() << " bytes" );
+  db.cache().limits( db_query_cache_entries, db_query_cache_bytes );
+  MINFO( db.cache().stats() );
+  db.list_chunk( db_list_chunk );
+  MINFO( "List chunk size: " << db.list_chunk() );
+  db.compact_interval( db_compact_interval );
+  db.compact_churn( db_compact_churn );
+  MINFO( "Compaction interval: " << db.compact_interval() << " s, churn: "
+         << db.compact_churn() );
+  db.tombstone_horizon( db_tombstone_horizon );
+  MINFO( "Tombstone horizon: " << db.tombstone_horizon() << " s" );
+
   // initially optionally populate database
-  auto ndoc = piac::get_doccount( db_name );
+  auto ndoc = piac::get_doccount( db );
   MINFO( "Initial number of documents: " << ndoc );
 
   // initially query hashes of db entries
-  db_update_hashes( db_name, my_hashes );
+  db_update_hashes( db, my_hashes );
 
   zmqpp::context ctx_rpc;
 
@@ -267,42 +709,114 @@ piac::db_thread(
     }
   }
   // create socket that will listen to clients via RPC
-  zmqpp::socket client( ctx_rpc, zmqpp::socket_type::reply );
+  zmqpp::socket frontend( ctx_rpc, zmqpp::socket_type::router );
   if (rpc_secure) {
-    client.set( zmqpp::socket_option::identity, "IDENT" );
+    frontend.set( zmqpp::socket_option::identity, "IDENT" );
     int as_server = 1;
-    client.set( zmqpp::socket_option::curve_server, as_server );
-    client.set( zmqpp::socket_option::curve_secret_key,
-                rpc_server_keys.secret_key );
+    frontend.set( zmqpp::socket_option::curve_server, as_server );
+    frontend.set( zmqpp::socket_option::curve_secret_key,
+                  rpc_server_keys.secret_key );
   }
-  try_bind( client, rpc_port, 10, use_strict_ports );
+  try_bind( frontend, rpc_port, 10, use_strict_ports );
 
   MINFO( "Bound to RPC port " << rpc_port );
   epee::set_console_color( epee::console_color_yellow, /* bright = */ false );
   std::cout << "Bound to RPC port " << rpc_port << '\n';
   epee::set_console_color( epee::console_color_default, /* bright = */ false );
 
+  // create socket that will listen to client requests that modify the db
+  zmqpp::socket client( ctx_rpc, zmqpp::socket_type::reply );
+  client.bind( "inproc://db_writer" );
+  // create sockets the router uses to forward client requests
+  zmqpp::socket workers( ctx_rpc, zmqpp::socket_type::dealer );
+  workers.bind( "inproc://db_workers" );
+  zmqpp::socket writer( ctx_rpc, zmqpp::socket_type::dealer );
+  writer.connect( "inproc://db_writer" );
+  // create socket that forwards lookups from peers to query workers
+  zmqpp::socket lookups( ctx_rpc, zmqpp::socket_type::dealer );
+  lookups.bind( "inproc://db_lookups" );
+
+  // start router and query workers, they run as long as this thread
+  std::vector< std::thread > threads;
+  threads.emplace_back( db_router, std::ref(frontend), std::ref(workers),
+                        std::ref(writer) );
+  auto nworkers = std::max< std::size_t >( db_query_threads, 1 );
+  for (std::size_t i = 0; i < nworkers; ++i)
+    threads.emplace_back( db_query_worker, std::ref(ctx_rpc), std::ref(db), i );
+  MINFO( "Query worker threads: " << nworkers );
+
   // create socket that will listen to requests for db lookups from peers
   zmqpp::socket db_p2p( ctx_db, zmqpp::socket_type::pair );
   db_p2p.bind( "inproc://db_p2p" );
   MDEBUG( "Bound to inproc:://db_p2p" );
 
-  // listen to messages
+  // coalesce writes arriving in bursts into single commits and notifications
+  GroupCommit group( db_group_commit_ms, db_group_commit_docs );
+  MINFO( "Group commit window: " << db_group_commit_ms << " ms, max "
+         << db_group_commit_docs << " documents" );
+
+  // listen to messages, wake up often enough to close the window in time
+  auto timeout = std::clamp< long >( static_cast< long >( db_group_commit_ms ),
+                                     1, 100 );
   zmqpp::poller poller;
   poller.add( db_p2p );
+  poller.add( lookups );
+  auto tombs_expired = std::chrono::steady_clock::now();
   while (1) {
 
     zmqpp::message msg;
     if (client.receive( msg, /* dont_block = */ true )) {
-      db_client_op( client, db_p2p, db_name, my_peers, my_hashes, msg );
+      db_client_op( client, group, db, my_hashes, msg );
     }
 
-    if (poller.poll(100)) {
+    if (poller.poll( timeout )) {
       if (poller.has_input( db_p2p )) {
         zmqpp::message m;
         db_p2p.receive( m );
-        db_peer_op( db_name, m, db_p2p, my_hashes );
+        if (m.get( 0 ) == "GET") {
+          // look up in a query worker, add empty delimiter for REP
+          m.push_front( "" );
+          lookups.send( m );
+        } else {
+          db_peer_op( db, m, db_p2p, group, my_hashes );
+        }
+      }
+      if (poller.has_input( lookups )) {
+        zmqpp::message m;
+        lookups.receive( m );
+        m.pop_front();
+        db_p2p.send( m );
       }
     }
+
+    if (group.due()) group.flush( db, db_p2p, my_hashes );
+
+    // maintenance commits, so only run it while no writes from peers are left
+    // to commit by the group commit, e.g., right after the window is flushed
+    if (group.empty()) {
+
+      // forget tombstones past their horizon, check once a minute
+      auto now = std::chrono::steady_clock::now();
+      if (now - tombs_expired >= std::chrono::minutes( 1 )) {
+        tombs_expired = now;
+        try {
+          auto expired = db.expire_tombstones( std::time( nullptr ) );
+          if (not expired.empty()) {
+            db.commit();
+            zmqpp::message note;
+            note << "UNTOMB" << std::to_string( expired.size() );
+            for (const auto& h : expired) note << h;
+            db_p2p.send( note );
+            MDEBUG( "Expired " << expired.size() << " tombstones" );
+          }
+        } catch ( const Xapian::Error& e ) {
+          MERROR( e.get_description() );
+        }
+      }
+
+      // compact in the background if due, swap in compacted db if done
+      auto report = db.maintain();
+      if (not report.empty()) MINFO( report );
+    }
   }
 }
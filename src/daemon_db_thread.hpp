@@ -10,9 +10,12 @@
 #pragma once
 
 #include <string>
-#include <unordered_set>
+#include <chrono>
+#include <unordered_map>
 
 #include "macro.hpp"
+#include "hash256.hpp"
+#include "tombstone.hpp"
 
 #if defined(__clang__)
   #pragma clang diagnostic push
@@ -35,39 +38,136 @@
 
 namespace piac {
 
+class Database;
+class IndexSchema;
+
+//! Default number of milliseconds writes are coalesced into a single commit
+const std::size_t DEFAULT_GROUP_COMMIT_MS = 100;
+//! Default maximum number of documents coalesced into a single commit
+const std::size_t DEFAULT_GROUP_COMMIT_DOCS = 1000;
+
+//! Writes coalesced into a single commit and a single change notification
+//! \details Documents inserted from peers are not committed right away but
+//!   once the group-commit window has passed since the first pending write or
+//!   enough documents are pending. Writes committed by client requests, e.g.,
+//!   adding and removing documents, also commit all pending documents, and
+//!   only their change notifications are coalesced. When the window closes,
+//!   the db hashes are updated and the p2p thread is notified once, also of
+//!   the tombstones of documents deleted, to pass on to peers.
+class GroupCommit {
+  public:
+    //! Constructor
+    GroupCommit( std::size_t window_ms, std::size_t max_docs ) :
+      m_window( window_ms ), m_max_docs( max_docs ), m_since(), m_added(),
+      m_removed(), m_buried(), m_pending(), m_uncommitted() {}
+
+    //! Record documents added, committed or left to commit
+    void added( const std::vector< std::string >& hashes, bool committed );
+
+    //! Forget documents left to commit, discarded by a failed write
+    void discard();
+
+    //! Record documents removed and committed
+    void removed( const std::vector< std::string >& hashes );
+
+    //! Record tombstones recorded and committed
+    void buried( const std::vector< Tombstone >& tombs );
+
+    //! Decide if a document has been added in the current window
+    bool pending( const Hash256& hash ) const {
+      return m_pending.contains( hash );
+    }
+
+    //! Decide if there are no changes in the window
+    bool empty() const {
+      return m_added.empty() && m_uncommitted.empty() && m_removed.empty() &&
+             m_buried.empty();
+    }
+
+    //! Decide if the window has closed
+    bool due() const;
+
+    //! Commit and notify of all changes in the window
+    void flush( Database& db,
+                zmqpp::socket& db_p2p,
+                HashSet& my_hashes );
+
+  private:
+    //! Record documents left to commit as committed
+    void committed();
+
+    //! Group-commit window
+    std::chrono::milliseconds m_window;
+    //! Maximum number of documents to leave uncommitted
+    std::size_t m_max_docs;
+    //! Time of the first write in the window
+    std::chrono::steady_clock::time_point m_since;
+    //! Hashes of documents added and committed in the window
+    std::vector< std::string > m_added;
+    //! Hashes of documents removed in the window
+    std::vector< std::string > m_removed;
+    //! Tombstones recorded in the window
+    std::vector< Tombstone > m_buried;
+    //! Hashes of documents added in the window, for lookup
+    HashSet m_pending;
+    //! Hashes of documents added in the window but not yet committed
+    std::vector< std::string > m_uncommitted;
+};
+
 extern std::mutex g_hashes_mtx;
 extern std::condition_variable g_hashes_cv;
 extern bool g_hashes_access;
 
+extern std::mutex g_peers_mtx;
+extern std::string g_peers_status;
+
 //! Update advertisement database hashes
 void
-db_update_hashes( const std::string& db_name,
-                  std::unordered_set< std::string >& my_hashes );
+db_update_hashes( Database& db,
+                  HashSet& my_hashes );
+
+//! Update advertisement database hashes incrementally
+void
+db_update_hashes( const std::vector< std::string >& added,
+                  const std::vector< std::string >& removed,
+                  HashSet& my_hashes );
 
 //! Perform a database operation for a client
 void
 db_client_op( zmqpp::socket& client,
-              zmqpp::socket& db_p2p,
-              const std::string& db_name,
-              const std::unordered_map< std::string, zmqpp::socket >& my_peers,
-              std::unordered_set< std::string >& my_hashes,
+              GroupCommit& group,
+              Database& db,
+              HashSet& my_hashes,
               zmqpp::message& msg );
 
 //! Perform an operation for a peer
 void
-db_peer_op( const std::string& db_name,
+db_peer_op( Database& db,
             zmqpp::message& msg,
             zmqpp::socket& db_p2p,
-            std::unordered_set< std::string >& my_hashes );
+            GroupCommit& group,
+            HashSet& my_hashes );
 
 //! Entry point to thread to perform database operations
 [[noreturn]] void
 db_thread( zmqpp::context& ctx_db,
            const std::string& db_name,
+           std::size_t db_index_threads,
+           std::size_t db_batch_docs,
+           std::size_t db_batch_bytes,
+           std::size_t db_query_cache_entries,
+           std::size_t db_query_cache_bytes,
+           std::size_t db_list_chunk,
+           std::size_t db_query_threads,
+           const IndexSchema& index_schema,
+           double db_compact_interval,
+           double db_compact_churn,
+           std::size_t db_group_commit_ms,
+           std::size_t db_group_commit_docs,
+           double db_tombstone_horizon,
            int rpc_port,
            bool use_strict_ports,
-           const std::unordered_map< std::string, zmqpp::socket >& my_peers,
-           std::unordered_set< std::string >& my_hashes,
+           HashSet& my_hashes,
            int rpc_secure,
            const zmqpp::curve::keypair& rpc_server_keys,
            const std::vector< std::string >& rpc_authorized_clients );
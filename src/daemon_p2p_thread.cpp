@@ -9,9 +9,13 @@
 
 #include <mutex>
 #include <condition_variable>
+#include <array>
+#include <limits>
+#include <algorithm>
 
 #include "logging_util.hpp"
 #include "crypto_util.hpp"
+#include "string_util.hpp"
 #include "zmq_util.hpp"
 #include "daemon_p2p_thread.hpp"
 
@@ -21,6 +25,485 @@ extern std::mutex g_hashes_mtx;
 extern std::condition_variable g_hashes_cv;
 extern bool g_hashes_access;
 
+extern std::mutex g_peers_mtx;
+extern std::string g_peers_status;
+
+static void
+p2p_send_recon( zmqpp::socket& sock,
+                int p2p_port,
+                const std::vector< Reconciler::Range >& ranges )
+// *****************************************************************************
+//! Send reconciliation message to peer
+//! \param[in,out] sock Socket of peer to send to
+//! \param[in] p2p_port Peer-to-peer port to use
+//! \param[in] ranges Ranges to send
+// *****************************************************************************
+{
+  zmqpp::message msg;
+  msg << "RECON";
+  msg << "localhost:" + std::to_string(p2p_port);
+  msg << std::to_string( ranges.size() );
+  for (const auto& r : ranges) {
+    msg << std::string( 1, r.mode );
+    msg << (r.end ? std::string() : r.upper.str());
+    if (r.mode == Reconciler::Range::FINGERPRINT) {
+      msg << std::to_string( r.count ) << r.fingerprint.str();
+    } else if (r.mode != Reconciler::Range::SKIP) {
+      msg << std::to_string( r.hashes.size() );
+      for (const auto& h : r.hashes) msg << h.str();
+    }
+  }
+  sock.send( msg );
+}
+
+static void
+p2p_send_hashes( zmqpp::socket& sock, int p2p_port, const HashSet& my_hashes )
+// *****************************************************************************
+//! Send all advertisement database hashes to peer
+//! \param[in,out] sock Socket of peer to send to
+//! \param[in] p2p_port Peer-to-peer port to use
+//! \param[in] my_hashes Set of advertisement database hashes to send
+//! \details Used for peers that support neither reconciliation nor deltas.
+// *****************************************************************************
+{
+  zmqpp::message msg;
+  msg << "HASH";
+  msg << "localhost:" + std::to_string(p2p_port);
+  msg << std::to_string( my_hashes.size() );
+  for (const auto& h : my_hashes) msg << h.str();
+  sock.send( msg );
+}
+
+static void
+p2p_send_delta( zmqpp::socket& sock,
+                int p2p_port,
+                std::uint64_t epoch,
+                const std::vector< ChangeLog::Change >& delta )
+// *****************************************************************************
+//! Send changes of advertisement database hashes to peer
+//! \param[in,out] sock Socket of peer to send to
+//! \param[in] p2p_port Peer-to-peer port to use
+//! \param[in] epoch Epoch of change log
+//! \param[in] delta Changes to send, consecutive sequence numbers
+// *****************************************************************************
+{
+  assert( not delta.empty() );
+  zmqpp::message msg;
+  msg << "DELTA";
+  msg << "localhost:" + std::to_string(p2p_port);
+  msg << std::to_string( epoch );
+  msg << std::to_string( delta.front().seq );
+  msg << std::to_string( delta.back().seq );
+  msg << std::to_string( delta.size() );
+  for (const auto& c : delta) msg << std::string( c.added ? "+" : "-" )
+                                  << c.hash.str();
+  sock.send( msg );
+}
+
+static void
+p2p_send_tombstones(
+  std::unordered_map< std::string, zmqpp::socket >& my_peers,
+  const std::string& to,
+  int p2p_port,
+  const std::vector< Tombstone >& tombs )
+// *****************************************************************************
+//! Send tombstones to peers
+//! \param[in,out] my_peers List of this daemon's peers (address and socket)
+//! \param[in] to Address of peer to send to, "*": all peers
+//! \param[in] p2p_port Peer-to-peer port to use
+//! \param[in] tombs Tombstones to send
+// *****************************************************************************
+{
+  if (tombs.empty()) return;
+  zmqpp::message msg;
+  msg << "TOMB";
+  msg << "localhost:" + std::to_string(p2p_port);
+  msg << std::to_string( tombs.size() );
+  for (const auto& t : tombs)
+    msg << t.hash << t.author << std::to_string( t.time ) << t.address
+        << t.signature;
+  for (auto& [addr,sock] : my_peers) {
+    if (to != "*" && addr != to) continue;
+    zmqpp::message m = msg.copy();
+    sock.send( m );
+  }
+}
+
+static bool
+p2p_want( const std::string& from,
+          const Hash256& h,
+          const std::unordered_map< std::string, zmqpp::socket >& my_peers,
+          const HashSet& my_hashes,
+          const Tombstones& tombs,
+          std::unordered_map< std::string, Transfer >& db_requests,
+          Lazy& lazy,
+          std::vector< Tombstone >& buried )
+// *****************************************************************************
+//! Request document from peer unless we have it or it has been deleted
+//! \param[in] from Address of peer that has the document
+//! \param[in] h Hash of document
+//! \param[in] my_peers List of this daemon's peers (address and socket)
+//! \param[in] my_hashes This daemon's set of advertisement database hashes
+//! \param[in] tombs Tombstones of documents deleted by their authors
+//! \param[in,out] db_requests Documents to request from multiple peers
+//! \param[in,out] lazy Peers that also announced documents being pulled
+//! \param[in,out] buried Tombstones to send back to the peer appended to
+//! \return True if requested
+//! \details A document announced by multiple peers is pulled from the first
+//!   one only, the others are remembered to pull from if it does not arrive,
+//!   so each document is transferred once, whatever the number of peers. The
+//!   tombstone of a document, if any, is sent back to the peer, which deletes
+//!   it before looking it up, if deleted by its author. The document is still
+//!   requested, as the tombstone may name another author, which is only known
+//!   once the document arrives and is checked before it is inserted.
+// *****************************************************************************
+{
+  if (h.zero() || my_hashes.contains( h )) return false;
+  auto t = tombs.find( h );
+  if (t != end(tombs)) buried.push_back( t->second );
+  // only pull from peers in the active view, the others are not sent to
+  if (my_peers.find( from ) == end(my_peers)) return false;
+  for (const auto& [addr,transfer] : db_requests) {
+    if (not transfer.wants( h )) continue;
+    if (addr != from) {
+      auto& a = lazy[ h ].from;
+      if (std::find( begin(a), end(a), from ) == end(a)) a.push_back( from );
+    }
+    return false;
+  }
+  db_requests[ from ].want( h );
+  return true;
+}
+
+static void
+p2p_graft( const std::unordered_map< std::string, zmqpp::socket >& my_peers,
+           const HashSet& my_hashes,
+           const Tombstones& tombs,
+           std::unordered_map< std::string, Transfer >& db_requests,
+           Lazy& lazy,
+           bool& to_send_db_requests )
+// *****************************************************************************
+//! Pull documents that did not arrive from the next peer that announced them
+//! \param[in] my_peers List of this daemon's peers (address and socket)
+//! \param[in] my_hashes This daemon's set of advertisement database hashes
+//! \param[in] tombs Tombstones of documents deleted by their authors
+//! \param[in,out] db_requests Documents to request from multiple peers
+//! \param[in,out] lazy Peers that also announced documents being pulled
+//! \param[in,out] to_send_db_requests Set to send db requests next
+//! \details A document no longer being pulled but not yet in the database may
+//!   still be on its way to the database, so it is only pulled again if it is
+//!   still missing the next time around.
+// *****************************************************************************
+{
+  {
+    std::unique_lock lock( g_hashes_mtx );
+    g_hashes_cv.wait( lock, []{ return g_hashes_access; } );
+  }
+
+  for (auto l = begin(lazy); l != end(lazy); ) {
+    const auto& h = l->first;
+    auto& a = l->second;
+    bool pulling = std::any_of( begin(db_requests), end(db_requests),
+                     [&]( const auto& r ){ return r.second.wants( h ); } );
+    if (my_hashes.contains( h ) || tombs.find( h ) != end(tombs)) {
+      l = lazy.erase( l );
+      continue;
+    }
+    if (pulling || not a.idle) {
+      a.idle = not pulling;
+      ++l;
+      continue;
+    }
+    while (not a.from.empty() &&
+           my_peers.find( a.from.back() ) == end(my_peers))
+    {
+      a.from.pop_back();
+    }
+    if (a.from.empty()) {
+      l = lazy.erase( l );
+      continue;
+    }
+    db_requests[ a.from.back() ].want( h );
+    MDEBUG( "Pulling " << hex( h.str() ) << " from " << a.from.back()
+            << " instead" );
+    a.from.pop_back();
+    a.idle = false;
+    to_send_db_requests = true;
+    ++l;
+  }
+}
+
+static void
+p2p_activate( zmqpp::context& ctx_p2p,
+              std::unordered_map< std::string, zmqpp::socket >& my_peers,
+              std::unordered_map< std::string, PeerSync >& peer_sync,
+              Overlay& overlay,
+              Liveness& live,
+              const std::string& addr,
+              bool& to_bcast_peers,
+              bool& to_bcast_hashes )
+// *****************************************************************************
+//! Connect to peer added to the active view
+//! \param[in,out] ctx_p2p ZMQ context used for peer-to-peer communication
+//! \param[in,out] my_peers List of this daemon's peers (address and socket)
+//! \param[in,out] peer_sync State of syncing hashes with peers known so far
+//! \param[in,out] overlay Membership of the overlay to remove peer passive from
+//! \param[in,out] live Liveness of peers to track peer by
+//! \param[in] addr Address of peer to connect to
+//! \param[in,out] to_bcast_peers Set to broadcast to peers next
+//! \param[in,out] to_bcast_hashes Set to broadcast hashes next
+//! \details Messages to the peer were dropped while it was not connected, e.g.,
+//!   while dead, so it is sent our list of peers and is synced with from
+//!   scratch.
+// *****************************************************************************
+{
+  overlay.forget( addr );
+  live.add( addr );
+  my_peers.insert_or_assign( addr, p2p_connect_peer( ctx_p2p, addr ) );
+  auto s = peer_sync.find( addr );
+  if (s != end(peer_sync)) s->second.synced = false;
+  to_bcast_peers = true;
+  to_bcast_hashes = true;
+}
+
+static void
+p2p_drop( zmqpp::context& ctx_p2p,
+          std::unordered_map< std::string, zmqpp::socket >& my_peers,
+          std::unordered_map< std::string, PeerSync >& peer_sync,
+          std::unordered_map< std::string, Transfer >& db_requests,
+          Liveness& live,
+          const std::string& addr,
+          int p2p_port )
+// *****************************************************************************
+//! Drop peer from the active view, or reject it, and tell it so
+//! \param[in,out] ctx_p2p ZMQ context used for peer-to-peer communication
+//! \param[in,out] my_peers List of this daemon's peers (address and socket)
+//! \param[in,out] peer_sync State of syncing hashes with peers known so far
+//! \param[in,out] db_requests Documents to request from multiple peers
+//! \param[in,out] live Liveness of peers to stop tracking peer by
+//! \param[in] addr Address of peer to drop
+//! \param[in] p2p_port Peer-to-peer port to use
+//! \details A peer rejected is not connected to, so it is told via a socket
+//!   created to that end. Either socket is kept open for a while after closed
+//!   to deliver the message. Documents being pulled from the peer are pulled
+//!   from peers that also announced them.
+// *****************************************************************************
+{
+  zmqpp::message msg;
+  msg << "DROP" << "localhost:" + std::to_string(p2p_port);
+  auto p = my_peers.find( addr );
+  if (p != end(my_peers)) {
+    p->second.set( zmqpp::socket_option::linger, PEER_DROP_LINGER_MS );
+    p->second.send( msg );
+    my_peers.erase( p );
+  } else {
+    auto sock = p2p_connect_peer( ctx_p2p, addr );
+    sock.set( zmqpp::socket_option::linger, PEER_DROP_LINGER_MS );
+    sock.send( msg );
+  }
+  live.remove( addr );
+  peer_sync.erase( addr );
+  db_requests.erase( addr );
+}
+
+static void
+p2p_fill( zmqpp::context& ctx_p2p,
+          std::unordered_map< std::string, zmqpp::socket >& my_peers,
+          std::unordered_map< std::string, PeerSync >& peer_sync,
+          Overlay& overlay,
+          Liveness& live,
+          bool& to_bcast_peers,
+          bool& to_bcast_hashes )
+// *****************************************************************************
+//! Fill the active view with random peers from the passive view
+//! \param[in,out] ctx_p2p ZMQ context used for peer-to-peer communication
+//! \param[in,out] my_peers List of this daemon's peers (address and socket)
+//! \param[in,out] peer_sync State of syncing hashes with peers known so far
+//! \param[in,out] overlay Membership of the overlay to take peers from
+//! \param[in,out] live Liveness of peers
+//! \param[in,out] to_bcast_peers Set to broadcast to peers next
+//! \param[in,out] to_bcast_hashes Set to broadcast hashes next
+// *****************************************************************************
+{
+  std::string addr;
+  while (my_peers.size() < overlay.active() && overlay.pick( addr )) {
+    if (my_peers.find( addr ) != end(my_peers) || live.dead( addr )) continue;
+    p2p_activate( ctx_p2p, my_peers, peer_sync, overlay, live, addr,
+                  to_bcast_peers, to_bcast_hashes );
+    MDEBUG( "Connecting to passive peer " << addr );
+  }
+}
+
+static void
+p2p_revive( zmqpp::context& ctx_p2p,
+            std::unordered_map< std::string, zmqpp::socket >& my_peers,
+            std::unordered_map< std::string, PeerSync >& peer_sync,
+            Overlay& overlay,
+            Liveness& live,
+            const std::string& addr,
+            bool& to_bcast_peers,
+            bool& to_bcast_hashes )
+// *****************************************************************************
+//! Reconnect to peer that was dead if the active view has room
+//! \param[in,out] ctx_p2p ZMQ context used for peer-to-peer communication
+//! \param[in,out] my_peers List of this daemon's peers (address and socket)
+//! \param[in,out] peer_sync State of syncing hashes with peers known so far
+//! \param[in,out] overlay Membership of the overlay
+//! \param[in,out] live Liveness of peers
+//! \param[in] addr Address of peer to reconnect to
+//! \param[in,out] to_bcast_peers Set to broadcast to peers next
+//! \param[in,out] to_bcast_hashes Set to broadcast hashes next
+//! \details If its place has been taken, the peer is remembered as passive.
+// *****************************************************************************
+{
+  if (my_peers.size() < overlay.active()) {
+    p2p_activate( ctx_p2p, my_peers, peer_sync, overlay, live, addr,
+                  to_bcast_peers, to_bcast_hashes );
+  } else {
+    live.remove( addr );
+    overlay.learn( addr );
+  }
+}
+
+static void
+p2p_check_peers( zmqpp::context& ctx_p2p,
+                 std::unordered_map< std::string, zmqpp::socket >& my_peers,
+                 std::unordered_map< std::string, PeerSync >& peer_sync,
+                 std::unordered_map< std::string, Transfer >& db_requests,
+                 Liveness& live,
+                 Overlay& overlay,
+                 const Compressor& zip,
+                 int p2p_port,
+                 bool& to_bcast_peers,
+                 bool& to_bcast_hashes )
+// *****************************************************************************
+//! Send heartbeats to peers, disconnect dead peers and reconnect to them
+//! \param[in,out] ctx_p2p ZMQ context used for peer-to-peer communication
+//! \param[in,out] my_peers List of this daemon's peers (address and socket)
+//! \param[in,out] peer_sync State of syncing hashes with peers known so far
+//! \param[in,out] db_requests Documents to request from multiple peers
+//! \param[in,out] live Liveness of peers
+//! \param[in,out] overlay Membership of the overlay
+//! \param[in] zip Compressor whose statistics to publish
+//! \param[in] p2p_port Peer-to-peer port to use
+//! \param[in,out] to_bcast_peers Set to broadcast to peers next
+//! \param[in,out] to_bcast_hashes Set to broadcast hashes next
+//! \details The socket of a dead peer is closed, discarding messages queued
+//!   for it, and it is no longer broadcast to, its place in the active view
+//!   taken by a passive peer. Documents requested from it are requested again
+//!   once it is back, unless it is forgotten. The liveness of peers, along
+//!   with the compression of documents sent to and received from them, is
+//!   published for the db thread to answer clients.
+// *****************************************************************************
+{
+  for (const auto& addr : live.expire()) {
+    my_peers.erase( addr );
+    MINFO( "Peer " << addr << " unresponsive, disconnected" );
+  }
+  for (const auto& addr : live.retry()) {
+    p2p_revive( ctx_p2p, my_peers, peer_sync, overlay, live, addr,
+                to_bcast_peers, to_bcast_hashes );
+    MDEBUG( "Reconnecting to peer " << addr );
+  }
+  for (const auto& addr : live.forget()) {
+    peer_sync.erase( addr );
+    db_requests.erase( addr );
+    MINFO( "Forgot peer " << addr );
+  }
+  p2p_fill( ctx_p2p, my_peers, peer_sync, overlay, live, to_bcast_peers,
+            to_bcast_hashes );
+
+  for (auto& [addr,sock] : my_peers) {
+    std::uint64_t seq = 0;
+    if (not live.ping( addr, seq )) continue;
+    zmqpp::message msg;
+    msg << "PING" << "localhost:" + std::to_string(p2p_port)
+        << std::to_string( seq );
+    sock.send( msg );
+  }
+
+  auto status = live.status();
+  if (overlay.passive()) {
+    if (not status.empty()) status += '\n';
+    status += std::to_string( overlay.passive() ) + " passive peers";
+  }
+  if (not status.empty() && not zip.capability().empty())
+    status += "\nCompression: " + zip.stats();
+  std::lock_guard lock( g_peers_mtx );
+  g_peers_status = std::move( status );
+}
+
+static bool
+p2p_legacy( const std::unordered_map< std::string, PeerSync >& peer_sync,
+            const std::string& addr )
+// *****************************************************************************
+//! Decide if a peer only understands requests and replies of db entries
+//! without flow control, "REQ addr size hashes..." and "DOC size docs..."
+//! \param[in] peer_sync State of syncing with peers, capabilities advertised
+//! \param[in] addr Address of peer
+//! \return True if the peer did not advertise reconciliation, which came with
+//!   chunked transfers
+// *****************************************************************************
+{
+  auto s = peer_sync.find( addr );
+  return s == end(peer_sync) || not s->second.recon;
+}
+
+static bool
+p2p_recv_recon( zmqpp::message& msg, std::vector< Reconciler::Range >& ranges )
+// *****************************************************************************
+//! Parse ranges of reconciliation message received from peer
+//! \param[in,out] msg Message to parse ranges from
+//! \param[in,out] ranges Ranges parsed
+//! \return True if the message is well-formed
+// *****************************************************************************
+{
+  using Range = Reconciler::Range;
+  if (msg.remaining() < 1) return false;
+  std::string size;
+  msg >> size;
+  std::size_t num = 0;
+  if (not to_number( size, num )) return false;
+  while (num-- != 0) {
+    if (msg.remaining() < 2) return false;
+    std::string mode, upper;
+    msg >> mode >> upper;
+    if (mode.size() != 1) return false;
+    Range r;
+    r.mode = static_cast< Range::Mode >( mode[0] );
+    r.end = upper.empty();
+    if (not r.end) {
+      if (upper.size() != Hash256::SIZE) return false;
+      r.upper = Hash256( upper );
+    }
+    if (r.mode == Range::FINGERPRINT) {
+      if (msg.remaining() < 2) return false;
+      std::string count, fp;
+      msg >> count >> fp;
+      if (fp.size() != Hash256::SIZE || not to_number( count, r.count ))
+        return false;
+      r.fingerprint = Hash256( fp );
+    } else if (r.mode == Range::LIST || r.mode == Range::NEED) {
+      if (msg.remaining() < 1) return false;
+      msg >> size;
+      std::size_t n = 0;
+      if (not to_number( size, n ) || msg.remaining() < n) return false;
+      r.hashes.reserve( n );
+      while (n-- != 0) {
+        std::string hash;
+        msg >> hash;
+        if (hash.size() != Hash256::SIZE) return false;
+        r.hashes.emplace_back( hash );
+      }
+    } else if (r.mode != Range::SKIP) {
+      return false;
+    }
+    ranges.push_back( std::move(r) );
+    if (ranges.back().end) break;
+  }
+  return true;
+}
+
 } // piac::
 
 zmqpp::socket
@@ -34,6 +517,13 @@ piac::p2p_connect_peer( zmqpp::context& ctx, const std::string& addr )
 {
   // create socket to connect to peer
   zmqpp::socket dealer( ctx, zmqpp::socket_type::dealer );
+  // bound messages queued for the peer and never block sending to it: if the
+  // peer is slow or gone, messages beyond the limit are dropped, which the
+  // protocol recovers from, and those queued are discarded once it is closed
+  dealer.set( zmqpp::socket_option::send_high_water_mark, PEER_HWM );
+  dealer.set( zmqpp::socket_option::receive_high_water_mark, PEER_HWM );
+  dealer.set( zmqpp::socket_option::send_timeout, 0 );
+  dealer.set( zmqpp::socket_option::linger, 0 );
   dealer.connect( "tcp://" + addr );
   MDEBUG( "Connecting to peer at " + addr );
   return dealer;
@@ -43,22 +533,40 @@ void
 piac::p2p_bcast_peers(
   int p2p_port,
   std::unordered_map< std::string, zmqpp::socket >& my_peers,
+  Overlay& overlay,
+  const Compressor& zip,
   bool& to_bcast_peers )
 // *****************************************************************************
 //  Broadcast to peers
 //! \param[in] p2p_port Peer-to-peer port to use
 //! \param[in] my_peers List of peers (address and socket) to broadcast to
+//! \param[in,out] overlay Membership of the overlay to sample peers from
+//! \param[in] zip Compressor whose capability to advertise
 //! \param[in,out] to_bcast_peers True to broadcast, false to not
+//! \details Each peer is sent a different random sample of our active and
+//!   passive views, so lists of peers stay bounded. The list of peers is
+//!   followed by the capabilities of range-based reconciliation of hashes and
+//!   of decompressing documents with our dictionary, if available, ignored by
+//!   peers that do not support them, and by a request to be accepted even if
+//!   the peer has no room, if we have no other peers.
 // *****************************************************************************
 {
   if (not to_bcast_peers) return;
 
+  std::vector< std::string > active;
+  for (const auto& [addr,sock] : my_peers) active.push_back( addr );
+  bool join = my_peers.size() <= 1;
+
   for (auto& [addr,sock] : my_peers) {
+    auto sample = overlay.sample( active );
     zmqpp::message msg;
     msg << "PEER";
-    msg << std::to_string( my_peers.size() + 1 );
+    msg << std::to_string( sample.size() + 1 );
     msg << "localhost:" + std::to_string(p2p_port);
-    for (const auto& [taddr,sock] : my_peers) msg << taddr;
+    for (const auto& taddr : sample) msg << taddr;
+    msg << "recon";
+    if (not zip.capability().empty()) msg << zip.capability();
+    if (join) msg << "join";
     sock.send( msg );
   }
 
@@ -69,14 +577,26 @@ void
 piac::p2p_bcast_hashes(
   int p2p_port,
   std::unordered_map< std::string, zmqpp::socket >& my_peers,
-  const std::unordered_set< std::string >& my_hashes,
+  const HashSet& my_hashes,
+  Reconciler& recon,
+  const ChangeLog& changes,
+  std::unordered_map< std::string, PeerSync >& peer_sync,
   bool& to_bcast_hashes )
 // *****************************************************************************
-//  Broadcast advertisement database hashes to peers
+//  Announce changes of advertisement database hashes to peers
 //! \param[in] p2p_port Peer-to-peer port to use
 //! \param[in,out] my_peers List of  peers (address and socket) to broadcast to
 //! \param[in] my_hashes Set of advertisement database hashes to broadcast
+//! \param[in,out] recon Reconciler holding a snapshot of hashes
+//! \param[in] changes Log of changes to hashes
+//! \param[in,out] peer_sync State of syncing hashes with peers known so far
 //! \param[in,out] to_bcast_hashes True to broadcast, false to not
+//! \details Peers supporting reconciliation are sent the changes since the
+//!   last one they acknowledged. Such a peer is fully reconciled with instead
+//!   when first found or if it fell behind further than the changes kept.
+//!   Peers that do not support reconciliation are sent all hashes whenever
+//!   they change. Peers not yet known either way are left until their list of
+//!   peers arrives, which triggers another broadcast.
 // *****************************************************************************
 {
   if (not to_bcast_hashes) return;
@@ -87,13 +607,27 @@ piac::p2p_bcast_hashes(
   }
 
   for (auto& [addr,sock] : my_peers) {
-    zmqpp::message msg;
-    msg << "HASH";
-    msg << "localhost:" + std::to_string(p2p_port);
-    msg << std::to_string( my_hashes.size() );
-    for (const auto& h : my_hashes) msg << h;
-    sock.send( msg );
-    MDEBUG( "Broadcasting " << my_hashes.size() << " hashes to " << addr );
+    auto p = peer_sync.find( addr );
+    if (p == end(peer_sync)) continue;
+    auto& s = p->second;
+    if (not s.recon) {
+      if (s.synced && s.acked == changes.seq()) continue;
+      p2p_send_hashes( sock, p2p_port, my_hashes );
+      MDEBUG( "Broadcasting " << my_hashes.size() << " hashes to " << addr );
+    } else {
+      std::vector< ChangeLog::Change > delta;
+      if (s.synced && changes.since( s.acked, delta )) {
+        if (delta.empty()) continue;
+        p2p_send_delta( sock, p2p_port, changes.epoch(), delta );
+        MDEBUG( "Sent " << delta.size() << " changes to " << addr );
+        continue;       // acked once the peer acknowledges
+      }
+      recon.refresh( my_hashes );
+      p2p_send_recon( sock, p2p_port, recon.initiate() );
+      MDEBUG( "Reconciling " << recon.size() << " hashes with " << addr );
+    }
+    s.synced = true;
+    s.acked = changes.seq();
   }
 
   to_bcast_hashes = false;
@@ -103,30 +637,48 @@ void
 piac::p2p_send_db_requests(
   int p2p_port,
   std::unordered_map< std::string, zmqpp::socket >& my_peers,
-  std::unordered_map< std::string,
-    std::unordered_set< std::string > >& db_requests,
+  std::unordered_map< std::string, Transfer >& db_requests,
+  const std::unordered_map< std::string, PeerSync >& peer_sync,
   bool& to_send_db_requests )
 // *****************************************************************************
 //  Send requests for advertisement database entries to peers
 //! \param[in] p2p_port Peer-to-peer port to use
 //! \param[in,out] my_peers List of  peers (address and socket) to broadcast to
-//! \param[in,out] db_requests Multiple ad requests from multiple peers
+//! \param[in,out] db_requests Documents to request from multiple peers
+//! \param[in] peer_sync State of syncing with peers, capabilities advertised
 //! \param[in,out] to_send_db_requests True to send requests, false to not
+//! \details Requests are sent in chunks as long as the peer has credits left,
+//!   the rest are sent as replies return credits. Peers not advertising
+//!   reconciliation get requests in the format without flow control, whose
+//!   replies carry no id, so their chunks are accounted for once sent.
 // *****************************************************************************
 {
   if (not to_send_db_requests) return;
 
-  for (auto&& [addr,hashes] : db_requests) {
-    zmqpp::message msg;
-    msg << "REQ";
-    msg << "localhost:" + std::to_string(p2p_port);
-    msg << std::to_string( hashes.size() );
-    for (const auto& h : hashes) msg << h;
-    hashes.clear();
-    my_peers.at( addr ).send( msg );
+  for (auto t = begin(db_requests); t != end(db_requests); ) {
+    auto& [addr,transfer] = *t;
+    auto p = my_peers.find( addr );
+    if (p == end(my_peers)) { ++t; continue; }
+    bool legacy = p2p_legacy( peer_sync, addr );
+    Transfer::Chunk chunk;
+    while (transfer.next( chunk )) {
+      zmqpp::message msg;
+      msg << "REQ";
+      msg << "localhost:" + std::to_string(p2p_port);
+      if (not legacy) {
+        msg << std::to_string( chunk.id );
+        msg << std::to_string( TRANSFER_CHUNK_BYTES );
+      }
+      msg << std::to_string( chunk.hashes.size() );
+      for (const auto& h : chunk.hashes) msg << h.str();
+      p->second.send( msg );
+      if (legacy) transfer.received( chunk.id, chunk.hashes.size() );
+      MDEBUG( "Requested " << chunk.hashes.size() << " db entries from "
+              << addr << ", " << transfer.size() << " outstanding" );
+    }
+    if (transfer.size() == 0) t = db_requests.erase( t ); else ++t;
   }
 
-  db_requests.clear();
   to_send_db_requests = false;
 }
 
@@ -136,9 +688,16 @@ piac::p2p_answer_p2p(
   zmqpp::socket& db_p2p,
   zmqpp::message& msg,
   std::unordered_map< std::string, zmqpp::socket >& my_peers,
-  const std::unordered_set< std::string >& my_hashes,
-  std::unordered_map< std::string,
-    std::unordered_set< std::string > >& db_requests,
+  const HashSet& my_hashes,
+  std::unordered_map< std::string, Transfer >& db_requests,
+  Lazy& lazy,
+  Reconciler& recon,
+  const ChangeLog& changes,
+  std::unordered_map< std::string, PeerSync >& peer_sync,
+  Compressor& zip,
+  const Tombstones& tombs,
+  Liveness& live,
+  Overlay& overlay,
   int p2p_port,
   bool& to_bcast_peers,
   bool& to_bcast_hashes,
@@ -151,6 +710,14 @@ piac::p2p_answer_p2p(
 //! \param[in,out] my_peers List of this daemon's peers (address and socket)
 //! \param[in] my_hashes This daemon's set of advertisement database hashes
 //! \param[in,out] db_requests Store multiple ad requests from multiple peers
+//! \param[in,out] lazy Peers that also announced documents being pulled
+//! \param[in,out] recon Reconciler holding a snapshot of this daemon's hashes
+//! \param[in] changes Log of changes to this daemon's hashes
+//! \param[in,out] peer_sync State of syncing hashes with peers known so far
+//! \param[in,out] zip Compressor to decompress documents with
+//! \param[in] tombs Tombstones of documents deleted by their authors
+//! \param[in,out] live Liveness of peers
+//! \param[in,out] overlay Membership of the overlay
 //! \param[in] p2p_port Peer-to-peer port to use
 //! \param[in,out] to_bcast_peers True to broadcast to peers next, false to not
 //! \param[in,out] to_bcast_hashes True to broadcast hashes next, false to not
@@ -163,22 +730,124 @@ piac::p2p_answer_p2p(
 
   if (cmd == "PEER") {
 
-    std::string size;
-    msg >> size;
-    std::size_t num = stoul( size );
+    std::string size, sender;
+    std::size_t num = 0;
+    if (msg.remaining() > 0) msg >> size;
+    if (not to_number( size, num ) || msg.remaining() < num) {
+      MERROR( "Malformed list of peers" );
+      return;
+    }
+    const auto self = "localhost:" + std::to_string(p2p_port);
     while (num-- != 0) {
       std::string addr;
       msg >> addr;
-      if (addr != "localhost:" + std::to_string(p2p_port) &&
-          my_peers.find(addr) == end(my_peers))
+      if (sender.empty()) { sender = addr; continue; }
+      // others listed are passive, dead peers are left to their backoff
+      if (addr != self && my_peers.find(addr) == end(my_peers) &&
+          not live.dead( addr ))
       {
-        my_peers.emplace( addr, p2p_connect_peer( ctx_p2p, addr ) );
-        to_bcast_peers = true;
-        to_bcast_hashes = true;
+        overlay.learn( addr );
       }
     }
+    // the sender is listed first, followed by its capabilities, if any
+    bool supports = false, compress = false, join = false;
+    while (msg.remaining() > 0) {
+      std::string cap;
+      msg >> cap;
+      if (cap == "recon") supports = true;
+      if (cap == "join") join = true;
+      if (not zip.capability().empty() && cap == zip.capability())
+        compress = true;
+    }
+    if (sender.empty() || sender == self) return;
+    live.heard( sender );
+    if (my_peers.find( sender ) == end(my_peers)) {
+      // accept the sender into the active view if it has room or if the
+      // sender has no other peers, dropping a random peer to make room
+      if (my_peers.size() >= overlay.active() && join) {
+        auto victim = std::next( begin(my_peers),
+          static_cast< long >( overlay.random( my_peers.size() ) ) )->first;
+        p2p_drop( ctx_p2p, my_peers, peer_sync, db_requests, live, victim,
+                  p2p_port );
+        overlay.learn( victim );
+        MDEBUG( "Dropped " << victim << " to make room for " << sender );
+      }
+      if (my_peers.size() < overlay.active()) {
+        p2p_activate( ctx_p2p, my_peers, peer_sync, overlay, live, sender,
+                      to_bcast_peers, to_bcast_hashes );
+      } else {
+        p2p_drop( ctx_p2p, my_peers, peer_sync, db_requests, live, sender,
+                  p2p_port );
+        overlay.learn( sender );
+        MDEBUG( "Rejected " << sender << ", no room" );
+        return;
+      }
+    }
+    p2p_fill( ctx_p2p, my_peers, peer_sync, overlay, live, to_bcast_peers,
+              to_bcast_hashes );
+    auto [p, inserted] = peer_sync.try_emplace( sender );
+    p->second.compress = compress;
+    if (inserted || p->second.recon != supports) {
+      p->second.recon = supports;
+      p->second.synced = false;
+      to_bcast_hashes = true;
+    }
     MDEBUG( "Number of peers: " << my_peers.size() );
 
+  } else if (cmd == "PING") {
+
+    // heartbeat, echo its sequence number
+    std::string from, seq;
+    if (msg.remaining() < 2) {
+      MERROR( "Malformed heartbeat" );
+      return;
+    }
+    msg >> from >> seq;
+    if (live.heard( from )) {
+      p2p_revive( ctx_p2p, my_peers, peer_sync, overlay, live, from,
+                  to_bcast_peers, to_bcast_hashes );
+      MINFO( "Peer " << from << " back" );
+    }
+    auto p = my_peers.find( from );
+    if (p != end(my_peers)) {
+      zmqpp::message pong;
+      pong << "PONG" << "localhost:" + std::to_string(p2p_port) << seq;
+      p->second.send( pong );
+    }
+
+  } else if (cmd == "PONG") {
+
+    std::string from, seq;
+    std::uint64_t n = 0;
+    if (msg.remaining() >= 2) msg >> from >> seq;
+    if (not to_number( seq, n )) {
+      MERROR( "Malformed heartbeat echo from " << from );
+      return;
+    }
+    if (live.pong( from, n )) {
+      p2p_revive( ctx_p2p, my_peers, peer_sync, overlay, live, from,
+                  to_bcast_peers, to_bcast_hashes );
+      MINFO( "Peer " << from << " back" );
+    }
+    auto s = live.find( from );
+    if (s) MDEBUG( "RTT to " << from << ": " << s->rtt << " ms" );
+
+  } else if (cmd == "DROP") {
+
+    // peer dropped us from its active view or rejected us: replace it
+    std::string from;
+    if (msg.remaining() > 0) msg >> from;
+    if (my_peers.find( from ) != end(my_peers)) {
+      my_peers.erase( from );
+      live.remove( from );
+      peer_sync.erase( from );
+      db_requests.erase( from );
+      p2p_fill( ctx_p2p, my_peers, peer_sync, overlay, live, to_bcast_peers,
+                to_bcast_hashes );
+      MDEBUG( "Dropped by " << from << ", number of peers: "
+              << my_peers.size() );
+    }
+
   } else if (cmd == "HASH") {
 
     {
@@ -186,28 +855,192 @@ piac::p2p_answer_p2p(
       g_hashes_cv.wait( lock, []{ return g_hashes_access; } );
     }
     std::string from, size;
-    msg >> from >> size;
-    std::size_t num = stoul( size );
+    std::size_t num = 0;
+    if (msg.remaining() >= 2) msg >> from >> size;
+    if (not to_number( size, num ) || msg.remaining() < num) {
+      MERROR( "Malformed hashes from " << from );
+      return;
+    }
+    std::vector< Tombstone > buried;
     while (num-- != 0) {
       std::string hash;
       msg >> hash;
-      if (my_hashes.find(hash) == end(my_hashes)) {
-        db_requests[ from ].insert( hash );
+      if (hash.size() != Hash256::SIZE) continue;
+      if (p2p_want( from, Hash256( hash ), my_peers, my_hashes, tombs,
+                    db_requests, lazy, buried ))
+      {
         to_send_db_requests = true;
       }
     }
+    // let the peer know of documents it still has that have been deleted
+    p2p_send_tombstones( my_peers, from, p2p_port, buried );
     auto r = db_requests.find( from );
     MDEBUG( "Recv " << (r != end(db_requests) ? r->second.size() : 0)
             << " hashes from " << from );
 
+  } else if (cmd == "RECON") {
+
+    {
+      std::unique_lock lock( g_hashes_mtx );
+      g_hashes_cv.wait( lock, []{ return g_hashes_access; } );
+    }
+    std::string from;
+    if (msg.remaining() > 0) msg >> from;
+    std::vector< Reconciler::Range > ranges;
+    if (not p2p_recv_recon( msg, ranges )) {
+      MERROR( "Malformed reconciliation message from " << from );
+      return;
+    }
+    peer_sync[ from ].recon = true;
+    recon.refresh( my_hashes );
+    std::vector< Hash256 > missing;
+    auto reply = recon.respond( ranges, missing );
+    std::size_t requested = 0;
+    std::vector< Tombstone > buried;
+    for (const auto& h : missing) {
+      if (p2p_want( from, h, my_peers, my_hashes, tombs, db_requests, lazy,
+                    buried ))
+      {
+        to_send_db_requests = true;
+        ++requested;
+      }
+    }
+    p2p_send_tombstones( my_peers, from, p2p_port, buried );
+    auto p = my_peers.find( from );
+    if (not reply.empty() && p != end(my_peers))
+      p2p_send_recon( p->second, p2p_port, reply );
+    if (reply.empty())
+      MDEBUG( "Reconciled with " << from << ", requesting " << requested
+              << " hashes" );
+    else
+      MDEBUG( "Reconciling with " << from << ", sent " << reply.size()
+              << " ranges, requesting " << requested << " hashes" );
+
+  } else if (cmd == "DELTA") {
+
+    {
+      std::unique_lock lock( g_hashes_mtx );
+      g_hashes_cv.wait( lock, []{ return g_hashes_access; } );
+    }
+    std::string from, epoch, first, last, size;
+    std::uint64_t e = 0, f = 0, l = 0;
+    std::size_t num = 0;
+    if (msg.remaining() >= 5) msg >> from >> epoch >> first >> last >> size;
+    if (not to_number( epoch, e ) || not to_number( first, f ) ||
+        not to_number( last, l ) || not to_number( size, num ))
+    {
+      MERROR( "Malformed changes from " << from );
+      return;
+    }
+    auto& s = peer_sync[ from ];
+    s.recon = true;
+    if (e != s.epoch ? f != 1 : f > s.seen + 1) {
+      // missed some changes, e.g., peer restarted or we did: reconcile fully
+      auto p = my_peers.find( from );
+      if (p != end(my_peers)) {
+        recon.refresh( my_hashes );
+        p2p_send_recon( p->second, p2p_port, recon.initiate() );
+      }
+      MDEBUG( "Gap in changes from " << from << ", reconciling" );
+    } else {
+      std::size_t requested = 0;
+      std::vector< Tombstone > buried;
+      while (num-- != 0 && msg.remaining() >= 2) {
+        std::string op, hash;
+        msg >> op >> hash;
+        // removals arrive as tombstones, only additions are requested
+        if (op != "+" || hash.size() != Hash256::SIZE) continue;
+        if (p2p_want( from, Hash256( hash ), my_peers, my_hashes, tombs,
+                      db_requests, lazy, buried ))
+        {
+          to_send_db_requests = true;
+          ++requested;
+        }
+      }
+      p2p_send_tombstones( my_peers, from, p2p_port, buried );
+      MDEBUG( "Recv changes " << f << '-' << l << " from " << from
+              << ", requesting " << requested << " hashes" );
+    }
+    s.seen = e == s.epoch ? std::max( s.seen, l ) : l;
+    s.epoch = e;
+    auto p = my_peers.find( from );
+    if (p != end(my_peers)) {
+      zmqpp::message ack;
+      ack << "ACK" << "localhost:" + std::to_string(p2p_port) << epoch << last;
+      p->second.send( ack );
+    }
+
+  } else if (cmd == "ACK") {
+
+    std::string from, epoch, seq;
+    std::uint64_t e = 0, n = 0;
+    if (msg.remaining() >= 3) msg >> from >> epoch >> seq;
+    if (not to_number( epoch, e ) || not to_number( seq, n )) {
+      MERROR( "Malformed acknowledgement from " << from );
+      return;
+    }
+    auto p = peer_sync.find( from );
+    if (p != end(peer_sync) && e == changes.epoch())
+      p->second.acked = std::max( p->second.acked, n );
+
+  } else if (cmd == "TOMB") {
+
+    std::string from, size;
+    std::size_t num = 0;
+    if (msg.remaining() >= 2) msg >> from >> size;
+    if (not to_number( size, num ) || msg.remaining() / 5 < num) {
+      MERROR( "Malformed tombstones from " << from );
+      return;
+    }
+    // pass tombstones not yet known to the db to verify and record
+    std::vector< std::array< std::string, 5 > > fresh;
+    while (num-- != 0) {
+      std::array< std::string, 5 > t;
+      msg >> t[0] >> t[1] >> t[2] >> t[3] >> t[4];
+      if (t[0].size() != Hash256::SIZE || t[1].empty() || t[2].empty() ||
+          t[2].size() > 18 ||
+          t[2].find_first_not_of( "0123456789" ) != std::string::npos ||
+          t[3].empty() || t[4].empty())
+      {
+        continue;
+      }
+      if (tombs.find( Hash256( t[0] ) ) == end(tombs))
+        fresh.push_back( std::move(t) );
+    }
+    if (not fresh.empty()) {
+      zmqpp::message del;
+      del << "DEL" << std::to_string( fresh.size() );
+      for (const auto& t : fresh) del << t[0] << t[1] << t[2] << t[3] << t[4];
+      db_p2p.send( del );
+    }
+    MDEBUG( "Recv " << fresh.size() << " new tombstones from " << from );
+
   } else if (cmd == "REQ") {
 
-    std::string addr, size;
-    msg >> addr >> size;
-    std::size_t num = stoul( size );
-    assert( num > 0 );
+    // peers without flow control send no id and budget, and are sent all
+    // documents found, in a reply without id, see p2p_answer_db()
+    std::string addr, id = "0", budget, size;
+    std::size_t num = 0, bytes = 0;
+    bool valid = false;
+    if (msg.remaining() > 0) msg >> addr;
+    if (p2p_legacy( peer_sync, addr )) {
+      if (msg.remaining() > 0) msg >> size;
+      bytes = std::numeric_limits< std::size_t >::max();
+      valid = true;
+    } else if (msg.remaining() >= 3) {
+      msg >> id >> budget >> size;
+      // never send more than a chunk, whatever the peer is willing to receive
+      valid = to_number( budget, bytes );
+      bytes = std::min( bytes, TRANSFER_CHUNK_BYTES );
+    }
+    if (not valid || not to_number( size, num ) || num == 0 ||
+        msg.remaining() != num)
+    {
+      MERROR( "Malformed request of db entries from " << addr );
+      return;
+    }
     zmqpp::message req;
-    req << "GET" << addr << size;
+    req << "GET" << addr << id << std::to_string( bytes ) << size;
     while (num-- != 0) {
       std::string hash;
       msg >> hash;
@@ -222,25 +1055,55 @@ piac::p2p_answer_p2p(
       std::unique_lock lock( g_hashes_mtx );
       g_hashes_cv.wait( lock, []{ return g_hashes_access; } );
     }
-    std::string size;
-    msg >> size;
-    MDEBUG( "Recv " << size << " db entries" );
-    std::size_t num = stoul( size );
-    assert( num > 0 );
-    std::vector< std::string > docs_to_insert;
+    std::string from, id, served, size;
+    std::uint64_t rid = 0;
+    std::size_t n = 0, num = 0;
+    if (msg.remaining() > 0) msg >> from;
+    // peers without flow control reply with the number of documents first,
+    // no address, and need no credit returned, see p2p_send_db_requests()
+    if (to_number( from, num ) && msg.remaining() == num) {
+      from.clear();
+      MDEBUG( "Recv " << num << " db entries" );
+    } else {
+      if (msg.remaining() >= 3) msg >> id >> served >> size;
+      if (not to_number( id, rid ) || not to_number( served, n ) ||
+          not to_number( size, num ) || msg.remaining() < num)
+      {
+        MERROR( "Malformed db entries from " << from );
+        return;
+      }
+      MDEBUG( "Recv " << num << " db entries from " << from );
+      // return credit, documents not looked up are requested again
+      auto t = db_requests.find( from );
+      if (t != end(db_requests)) {
+        t->second.received( rid, n );
+        if (t->second.size() == 0) db_requests.erase( t );
+        to_send_db_requests = true;
+      }
+    }
+    std::vector< std::string > docs;
     while (num-- != 0) {
       std::string doc;
       msg >> doc;
-      auto hash = sha256( doc );
-      if (my_hashes.find(hash) == end(my_hashes)) {
-        docs_to_insert.emplace_back( std::move(doc) );
+      if (zip.decompress( doc )) {
+        docs.emplace_back( std::move(doc) );
+      } else {
+        MWARNING( "Could not decompress db entry from " << from );
       }
     }
-    zmqpp::message req;
-    req << "INS" << std::to_string( docs_to_insert.size() );
-    for (const auto& doc : docs_to_insert) req << doc;
-    db_p2p.send( req );
-    MDEBUG( "Attempting to insert " << docs_to_insert.size() << " db entries" );
+    // hash once here, the hashes travel with the documents to the index
+    auto hashes = sha256_batch( docs );
+    std::vector< std::size_t > to_insert;
+    for (std::size_t i = 0; i < docs.size(); ++i) {
+      if (not my_hashes.contains( hashes[i] )) to_insert.push_back( i );
+    }
+    if (not to_insert.empty()) {
+      zmqpp::message req;
+      req << "INS" << std::to_string( to_insert.size() );
+      for (auto i : to_insert) req << hashes[i].str() << docs[i];
+      db_p2p.send( req );
+    }
+    MDEBUG( "Attempting to insert " << to_insert.size() << " db entries" );
 
   } else {
 
@@ -252,11 +1115,24 @@ piac::p2p_answer_p2p(
 void
 piac::p2p_answer_db( zmqpp::message& msg,
                      std::unordered_map< std::string, zmqpp::socket >& my_peers,
+                     Reconciler& recon,
+                     ChangeLog& changes,
+                     const std::unordered_map< std::string, PeerSync >&
+                       peer_sync,
+                     Compressor& zip,
+                     Tombstones& tombs,
+                     int p2p_port,
                      bool& to_bcast_hashes )
 // *****************************************************************************
 //  Answer request from db thread
 //! \param[in,out] msg Incoming message to answer
 //! \param[in,out] my_peers List of this daemon's peers (address and socket)
+//! \param[in,out] recon Reconciler whose snapshot to invalidate on changes
+//! \param[in,out] changes Log of changes to append changes to
+//! \param[in] peer_sync State of syncing with peers, whether to compress
+//! \param[in,out] zip Compressor to compress documents with
+//! \param[in,out] tombs Tombstones of documents deleted by their authors
+//! \param[in] p2p_port Peer-to-peer port to use
 //! \param[in,out] to_bcast_hashes True to broadcast hashes next, false to not
 // *****************************************************************************
 {
@@ -266,25 +1142,79 @@ piac::p2p_answer_db( zmqpp::message& msg,
 
   if (cmd == "PUT") {
 
-    std::string addr, size;
-    msg >> addr >> size;
+    std::string addr, id, served, size;
+    msg >> addr >> id >> served >> size;
     MDEBUG( "Prepared " << size << " db entries for " << addr );
     std::size_t num = stoul( size );
-    assert( num > 0 );
     zmqpp::message rep;
-    rep << "DOC" << size;
+    rep << "DOC";
+    // peers without flow control expect the documents only
+    bool legacy = p2p_legacy( peer_sync, addr );
+    if (not legacy)
+      rep << "localhost:" + std::to_string(p2p_port) << id << served;
+    rep << size;
+    // compress for peers that can decompress with the same dictionary
+    auto s = peer_sync.find( addr );
+    bool compress = s != end(peer_sync) && s->second.compress;
     while (num-- != 0) {
       std::string doc;
       msg >> doc;
-      rep << doc;
+      if (compress) rep << zip.compress( doc ); else rep << doc;
+    }
+    // reply even if no documents found, so the peer gets its credit back
+    auto p = my_peers.find( addr );
+    if (p != end(my_peers) && (not legacy || size != "0")) {
+      p->second.send( rep );
+      MDEBUG( "Sent back " << size << " db entries to " << addr );
+      if (compress) MDEBUG( "Compression: " << zip.stats() );
     }
-    my_peers.at( addr ).send( rep );
-    MDEBUG( "Sent back " << size << " db entries to " << addr );
 
   } else if (cmd == "NEW") {
 
+    // hashes removed, then hashes added
+    for (bool added : { false, true }) {
+      std::string size;
+      msg >> size;
+      std::size_t num = stoul( size );
+      while (num-- != 0) {
+        std::string hash;
+        msg >> hash;
+        if (hash.size() == Hash256::SIZE)
+          changes.append( Hash256( hash ), added );
+      }
+    }
+    recon.invalidate();
     to_bcast_hashes = true;
 
+  } else if (cmd == "TOMB") {
+
+    // tombstones recorded by the db, remember and pass on if addressed
+    std::string to, size;
+    msg >> to >> size;
+    std::size_t num = stoul( size );
+    std::vector< Tombstone > buried( num );
+    for (auto& t : buried) {
+      std::string time;
+      msg >> t.hash >> t.author >> time >> t.address >> t.signature;
+      t.time = stoll( time );
+      if (t.hash.size() == Hash256::SIZE) tombs[ Hash256( t.hash ) ] = t;
+    }
+    if (not to.empty()) p2p_send_tombstones( my_peers, to, p2p_port, buried );
+    MDEBUG( "Number of tombstones: " << tombs.size() );
+
+  } else if (cmd == "UNTOMB") {
+
+    // tombstones past their horizon
+    std::string size;
+    msg >> size;
+    std::size_t num = stoul( size );
+    while (num-- != 0) {
+      std::string hash;
+      msg >> hash;
+      if (hash.size() == Hash256::SIZE) tombs.erase( Hash256( hash ) );
+    }
+    MDEBUG( "Number of tombstones: " << tombs.size() );
+
   } else {
 
     MERROR( "unknown cmd" );
@@ -296,7 +1226,9 @@ piac::p2p_answer_db( zmqpp::message& msg,
 piac::p2p_thread( zmqpp::context& ctx_p2p,
                   zmqpp::context& ctx_db,
                   std::unordered_map< std::string, zmqpp::socket >& my_peers,
-                  const std::unordered_set< std::string >& my_hashes,
+                  const HashSet& my_hashes,
+                  double p2p_peer_timeout,
+                  std::size_t p2p_fanout,
                   int default_p2p_port,
                   int p2p_port,
                   bool use_strict_ports )
@@ -306,6 +1238,8 @@ piac::p2p_thread( zmqpp::context& ctx_p2p,
 //! \param[in,out] ctx_db ZMQ context used for communication with the db thread
 //! \param[in,out] my_peers List of this daemon's peers (address and socket)
 //! \param[in] my_hashes This daemon's set of advertisement database hashes
+//! \param[in] p2p_peer_timeout Seconds without hearing from a peer it is dead
+//! \param[in] p2p_fanout Number of peers to forward announcements to
 //! \param[in] default_p2p_port Port to use by default for peer communication
 //! \param[in] p2p_port Port that is used for peer communication
 //! \param[in] use_strict_ports True to try only the default port
@@ -316,6 +1250,8 @@ piac::p2p_thread( zmqpp::context& ctx_p2p,
 
   // create socket that will listen to peers and bind to p2p port
   zmqpp::socket router( ctx_p2p, zmqpp::socket_type::router );
+  router.set( zmqpp::socket_option::send_high_water_mark, PEER_HWM );
+  router.set( zmqpp::socket_option::receive_high_water_mark, PEER_HWM );
   try_bind( router, p2p_port, 10, use_strict_ports );
   MINFO( "Bound to P2P port " << p2p_port );
 
@@ -325,8 +1261,20 @@ piac::p2p_thread( zmqpp::context& ctx_p2p,
   for (int p = default_p2p_port; p < p2p_port; ++p)
     my_peers.emplace( "localhost:" + std::to_string( p ),
                       zmqpp::socket( ctx_p2p, zmqpp::socket_type::dealer ) );
-  // initially connect to peers
-  for (auto& [addr,sock] : my_peers) sock = p2p_connect_peer( ctx_p2p, addr );
+  // peers beyond the active view of the overlay are remembered as passive
+  Overlay overlay( p2p_fanout );
+  while (my_peers.size() > overlay.active()) {
+    auto r = static_cast< long >( overlay.random( my_peers.size() ) );
+    auto p = std::next( begin(my_peers), r );
+    overlay.learn( p->first );
+    my_peers.erase( p );
+  }
+  // initially connect to peers, liveness of peers tracked by heartbeats
+  Liveness live( p2p_peer_timeout );
+  for (auto& [addr,sock] : my_peers) {
+    sock = p2p_connect_peer( ctx_p2p, addr );
+    live.add( addr );
+  }
   MDEBUG( "Initial number of peers: " << my_peers.size() );
 
   { // log initial number of hashes (populated by db thread)
@@ -340,8 +1288,23 @@ piac::p2p_thread( zmqpp::context& ctx_p2p,
   db_p2p.connect( "inproc://db_p2p" );
   MDEBUG( "Connected to inproc:://db_p2p" );
 
-  std::unordered_map< std::string, std::unordered_set< std::string > >
-    db_requests;
+  std::unordered_map< std::string, Transfer > db_requests;
+  // peers that also announced documents being pulled, to pull from next
+  Lazy lazy;
+  // snapshot of hashes to reconcile with peers, log of changes to announce,
+  // state of syncing with peers
+  Reconciler recon;
+  ChangeLog changes;
+  std::unordered_map< std::string, PeerSync > peer_sync;
+  // tombstones of documents deleted by their authors, as recorded by the db
+  Tombstones tombs;
+  db_p2p.send( "TOMBS" );
+  // compression of documents sent to peers
+  Compressor zip;
+  if (zip.capability().empty())
+    MINFO( "Document compression not available" );
+  else
+    MINFO( "Document compression: " << zip.capability() );
 
   // listen to peers
   zmqpp::poller poller;
@@ -350,25 +1313,54 @@ piac::p2p_thread( zmqpp::context& ctx_p2p,
   bool to_bcast_peers = true;
   bool to_bcast_hashes = true;
   bool to_send_db_requests = false;
+  Liveness::clock::time_point checked, shuffled = Liveness::clock::now();
 
   while (1) {
-    p2p_bcast_peers( p2p_port, my_peers, to_bcast_peers );
-    p2p_bcast_hashes( p2p_port, my_peers, my_hashes, to_bcast_hashes );
-    p2p_send_db_requests( p2p_port, my_peers, db_requests,
+    // heartbeats, liveness of peers and documents to pull again, about once a
+    // second, and random samples of peers to refresh passive views
+    auto now = Liveness::clock::now();
+    if (now - checked >= std::chrono::seconds( 1 )) {
+      p2p_check_peers( ctx_p2p, my_peers, peer_sync, db_requests, live,
+                       overlay, zip, p2p_port, to_bcast_peers,
+                       to_bcast_hashes );
+      p2p_graft( my_peers, my_hashes, tombs, db_requests, lazy,
+                 to_send_db_requests );
+      checked = now;
+    }
+    if (now - shuffled >= std::chrono::milliseconds( PEER_SHUFFLE_MS )) {
+      to_bcast_peers = true;
+      shuffled = now;
+    }
+
+    p2p_bcast_peers( p2p_port, my_peers, overlay, zip, to_bcast_peers );
+    p2p_bcast_hashes( p2p_port, my_peers, my_hashes, recon, changes,
+                      peer_sync, to_bcast_hashes );
+    p2p_send_db_requests( p2p_port, my_peers, db_requests, peer_sync,
                           to_send_db_requests );
 
-    if (poller.poll()) {
+    // request again documents whose requests were not replied to in time
+    for (auto& [addr,transfer] : db_requests) {
+      auto expired = transfer.expire();
+      if (expired) {
+        MDEBUG( expired << " requests to " << addr << " timed out" );
+        to_send_db_requests = true;
+      }
+    }
+
+    if (poller.poll( 1000 )) {
       if (poller.has_input( router )) {
         zmqpp::message msg;
         router.receive( msg );
         p2p_answer_p2p( ctx_p2p, db_p2p, msg, my_peers, my_hashes, db_requests,
-                        p2p_port, to_bcast_peers, to_bcast_hashes,
+                        lazy, recon, changes, peer_sync, zip, tombs, live,
+                        overlay, p2p_port, to_bcast_peers, to_bcast_hashes,
                         to_send_db_requests );
       }
       if (poller.has_input( db_p2p )) {
         zmqpp::message msg;
         db_p2p.receive( msg );
-        p2p_answer_db( msg, my_peers, to_bcast_hashes );
+        p2p_answer_db( msg, my_peers, recon, changes, peer_sync, zip, tombs,
+                       p2p_port, to_bcast_hashes );
       }
     }
   }
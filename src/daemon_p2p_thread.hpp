@@ -10,6 +10,13 @@
 #pragma once
 
 #include "macro.hpp"
+#include "reconcile.hpp"
+#include "changelog.hpp"
+#include "transfer.hpp"
+#include "compress.hpp"
+#include "tombstone.hpp"
+#include "liveness.hpp"
+#include "overlay.hpp"
 
 #if defined(__clang__)
   #pragma clang diagnostic push
@@ -30,6 +37,36 @@
 
 namespace piac {
 
+//! State of syncing advertisement database hashes with a peer
+struct PeerSync {
+  //! True if the peer supports reconciliation and announcements of changes
+  bool recon = false;
+  //! True once the peer has been sent all hashes or fully reconciled with
+  bool synced = false;
+  //! Sequence number of our last change the peer acknowledged
+  std::uint64_t acked = 0;
+  //! Epoch of the peer's log of changes
+  std::uint64_t epoch = 0;
+  //! Sequence number of the peer's last change received
+  std::uint64_t seen = 0;
+  //! True if the peer decompresses documents compressed with our dictionary
+  bool compress = false;
+};
+
+//! Tombstones of documents deleted by their authors associated to their hashes
+using Tombstones = std::unordered_map< Hash256, Tombstone, Hash256::Hasher >;
+
+//! Peers that also announced a document being pulled from another peer
+struct Announced {
+  //! Addresses of peers that announced the document, to pull from next
+  std::vector< std::string > from;
+  //! True if the document was neither being pulled nor arrived when last seen
+  bool idle = false;
+};
+
+//! Peers that also announced documents being pulled associated to their hashes
+using Lazy = std::unordered_map< Hash256, Announced, Hash256::Hasher >;
+
 //! Create ZeroMQ socket and onnect to peer piac daemon
 zmqpp::socket
 p2p_connect_peer( zmqpp::context& ctx, const std::string& addr );
@@ -39,13 +76,18 @@ p2p_connect_peer( zmqpp::context& ctx, const std::string& addr );
 void
 p2p_bcast_peers( int p2p_port,
                  std::unordered_map< std::string, zmqpp::socket >& my_peers,
+                 Overlay& overlay,
+                 const Compressor& zip,
                  bool& to_bcast_peers );
 
-//! Broadcast advertisement database hashes to peers
+//! Announce changes of advertisement database hashes to peers
 void
 p2p_bcast_hashes( int p2p_port,
                   std::unordered_map< std::string, zmqpp::socket >& my_peers,
-                  const std::unordered_set< std::string >& my_hashes,
+                  const HashSet& my_hashes,
+                  Reconciler& recon,
+                  const ChangeLog& changes,
+                  std::unordered_map< std::string, PeerSync >& peer_sync,
                   bool& to_bcast_hashes );
 
 //! Send requests for advertisement database entries to peers
@@ -53,8 +95,8 @@ void
 p2p_send_db_requests(
   int p2p_port,
   std::unordered_map< std::string, zmqpp::socket >& my_peers,
-  std::unordered_map< std::string,
-    std::unordered_set< std::string > >& db_requests,
+  std::unordered_map< std::string, Transfer >& db_requests,
+  const std::unordered_map< std::string, PeerSync >& peer_sync,
   bool& to_send_db_requests );
 
 //! Answer peer's request
@@ -63,9 +105,16 @@ p2p_answer_p2p( zmqpp::context& ctx_p2p,
                 zmqpp::socket& db_p2p,
                 zmqpp::message& msg,
                 std::unordered_map< std::string, zmqpp::socket >& my_peers,
-                const std::unordered_set< std::string >& my_hashes,
-                std::unordered_map< std::string,
-                  std::unordered_set< std::string > >& db_requests,
+                const HashSet& my_hashes,
+                std::unordered_map< std::string, Transfer >& db_requests,
+                Lazy& lazy,
+                Reconciler& recon,
+                const ChangeLog& changes,
+                std::unordered_map< std::string, PeerSync >& peer_sync,
+                Compressor& zip,
+                const Tombstones& tombs,
+                Liveness& live,
+                Overlay& overlay,
                 int p2p_port,
                 bool& to_bcast_peers,
                 bool& to_bcast_hashes,
@@ -75,6 +124,12 @@ p2p_answer_p2p( zmqpp::context& ctx_p2p,
 void
 p2p_answer_db( zmqpp::message& msg,
                std::unordered_map< std::string, zmqpp::socket >& my_peers,
+               Reconciler& recon,
+               ChangeLog& changes,
+               const std::unordered_map< std::string, PeerSync >& peer_sync,
+               Compressor& zip,
+               Tombstones& tombs,
+               int p2p_port,
                bool& to_bcast_hashes );
 
 //! Entry point to thread to communicate with peers
@@ -82,7 +137,9 @@ p2p_answer_db( zmqpp::message& msg,
 p2p_thread( zmqpp::context& ctx_p2p,
             zmqpp::context& ctx_db,
             std::unordered_map< std::string, zmqpp::socket >& my_peers,
-            const std::unordered_set< std::string >& my_hashes,
+            const HashSet& my_hashes,
+            double p2p_peer_timeout,
+            std::size_t p2p_fanout,
             int default_p2p_port,
             int p2p_port,
             bool use_strict_ports );
@@ -8,38 +8,935 @@
 // *****************************************************************************
 
 #include <string>
+#include <thread>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <filesystem>
+#include <memory>
+#include <algorithm>
+#include <map>
+#include <exception>
+#include <limits>
 
 #include "string_util.hpp"
 #include "logging_util.hpp"
 #include "crypto_util.hpp"
+#include "signature.hpp"
 #include "db.hpp"
 #include "document.hpp"
 
+using piac::Database;
+
+namespace piac {
+
+//! Minimum number of documents per thread worth building shards for
+static const std::size_t MIN_BULK_DOCS_PER_THREAD = 256;
+//! Number of times a view tries to open a database being replaced
+static const int MAX_VIEW_OPEN_TRIES = 100;
+
+static double
+now()
+// *****************************************************************************
+//! Current time in seconds since epoch
+//! \return Seconds since epoch
+// *****************************************************************************
+{
+  std::chrono::duration< double > t =
+    std::chrono::system_clock::now().time_since_epoch();
+  return t.count();
+}
+
+static std::string
+timestamp( double t )
+// *****************************************************************************
+//! Format time as a UTC timestamp
+//! \param[in] t Seconds since epoch, 0 if unknown
+//! \return Formatted UTC timestamp
+// *****************************************************************************
+{
+  if (t <= 0.0) return "unknown";
+  auto s = static_cast< std::time_t >( t );
+  std::stringstream ss;
+  ss << std::put_time( std::gmtime( &s ), "%Y-%m-%d %H:%M:%S UTC" );
+  return ss.str();
+}
+
+static bool
+signed_by_author( const Tombstone& t, std::int64_t now, double horizon )
+// *****************************************************************************
+//! Verify that a tombstone is signed by the author of the document deleted
+//! \param[in] t Tombstone to verify
+//! \param[in] now Current time, seconds since the epoch
+//! \param[in] horizon Number of seconds tombstones are kept for
+//! \return True if the author is the hash of the address the tombstone was
+//!   signed by, the signature is valid, and the tombstone is not past its
+//!   horizon nor dated ahead by more than the skew allowed
+// *****************************************************************************
+{
+  return t.hash.size() == Hash256::SIZE &&
+         t.time <= now + TOMBSTONE_MAX_SKEW &&
+         static_cast< double >( now - t.time ) <= horizon &&
+         not t.address.empty() && sha256( t.address ) == t.author &&
+         verify_message( t.address, t.message(), t.signature );
+}
+
+static std::uintmax_t
+disk_size( const std::string& dir )
+// *****************************************************************************
+//! Size of files in a directory
+//! \param[in] dir Directory whose size to return
+//! \return Sum of sizes of regular files in directory and its subdirectories
+// *****************************************************************************
+{
+  std::uintmax_t bytes = 0;
+  std::error_code ec;
+  for (const auto& f : std::filesystem::recursive_directory_iterator( dir, ec ))
+  {
+    if (f.is_regular_file( ec )) bytes += f.file_size( ec );
+  }
+  return bytes;
+}
+
+static Xapian::rev
+catch_up( const std::string& name, const std::string& copy_name,
+          Xapian::rev rev )
+// *****************************************************************************
+//! Bring a copy of a database up to date with the database
+//! \param[in] name Name of Xapian database to copy from
+//! \param[in] copy_name Name of Xapian database copy to update
+//! \param[in] rev Revision of the database the copy is at
+//! \return Revision of the database the copy is at after the update
+//! \details The copy keeps the document ids of the database, as compacted
+//!   without renumbering, so the changes since the copy was taken are replayed
+//!   by document id: the hash terms of both are walked in order and a document
+//!   whose hash is only in the copy, or is at a different document id, e.g.,
+//!   removed and added again, is deleted from the copy by its id, and one only
+//!   in the database, or at a different id, is copied at its id. A document is
+//!   identified by the hash of its content, so one at the same hash and id has
+//!   not changed. Metadata, e.g., author aggregates, is copied over as well.
+//!   Nothing is done if the database has not changed.
+// *****************************************************************************
+{
+  Xapian::Database live( name );
+  if (live.get_revision() == rev) return rev;
+  Xapian::WritableDatabase copy( copy_name, Xapian::DB_OPEN );
+  auto l = live.allterms_begin( "Q" ), le = live.allterms_end( "Q" );
+  auto c = copy.allterms_begin( "Q" ), ce = copy.allterms_end( "Q" );
+  std::vector< Xapian::docid > gone, added;
+  while (l != le || c != ce) {
+    if (c == ce || (l != le && *l < *c)) {
+      added.push_back( *live.postlist_begin( *l ) );
+      ++l;
+    } else if (l == le || *c < *l) {
+      gone.push_back( *copy.postlist_begin( *c ) );
+      ++c;
+    } else {
+      auto lid = *live.postlist_begin( *l ), cid = *copy.postlist_begin( *c );
+      if (lid != cid) {
+        gone.push_back( cid );
+        added.push_back( lid );
+      }
+      ++l;
+      ++c;
+    }
+  }
+  for (auto id : gone) copy.delete_document( id );
+  for (auto id : added) copy.replace_document( id, live.get_document( id ) );
+  std::vector< std::string > keys;
+  for (auto k = copy.metadata_keys_begin(); k != copy.metadata_keys_end(); ++k)
+    keys.push_back( *k );
+  for (const auto& k : keys) copy.set_metadata( k, live.get_metadata( k ) );
+  for (auto k = live.metadata_keys_begin(); k != live.metadata_keys_end(); ++k)
+    copy.set_metadata( *k, live.get_metadata( *k ) );
+  copy.commit();
+  MDEBUG( "Compacted copy caught up: +" << added.size() << ", -"
+          << gone.size() );
+  return live.get_revision();
+}
+
+} // piac::
+
+void
+piac::setup_indexer( Xapian::TermGenerator& indexer,
+                     const Xapian::Stem& stemmer )
+// *****************************************************************************
+//  Configure indexer to index documents the same way everywhere
+//! \param[in,out] indexer Indexer to configure
+//! \param[in] stemmer Stemmer to use
+// *****************************************************************************
+{
+  indexer.set_stemmer( stemmer );
+  indexer.set_stemming_strategy( indexer.STEM_SOME_FULL_POS );
+}
+
+Database::Database( const std::string& name, const IndexSchema& schema ) :
+  m_name( name ),
+  m_writer(),
+  m_reader(),
+  m_stemmer( "english" ),
+  m_indexer(),
+  m_parser(),
+  m_index_threads( 1 ),
+  m_batch_docs( DEFAULT_BATCH_DOCS ),
+  m_batch_bytes( DEFAULT_BATCH_BYTES ),
+  m_list_chunk( DEFAULT_LIST_CHUNK ),
+  m_cache(),
+  m_schema( schema ),
+  m_indexed_docs( 0 ),
+  m_index_seconds( 0.0 ),
+  m_compact_interval( DEFAULT_COMPACT_INTERVAL ),
+  m_compact_churn( DEFAULT_COMPACT_CHURN ),
+  m_tombstone_horizon( DEFAULT_TOMBSTONE_HORIZON ),
+  m_churn( 0 ),
+  m_compacted( std::chrono::steady_clock::now() ),
+  m_compact_start(),
+  m_compact_before( 0 ),
+  m_compact_rounds( 0 ),
+  m_compaction(),
+  m_compact_report(),
+  m_primary( nullptr ),
+  m_generation( 0 )
+// *****************************************************************************
+//  Constructor: open database, create if it does not yet exist
+//! \param[in] name Name of Xapian db to operate on
+//! \param[in] schema Index schema configuring how document fields are indexed
+//! \details If the database was indexed with a different index schema, all
+//!   documents are reindexed using the one given.
+// *****************************************************************************
+{
+  // recover from an interrupted replace()
+  auto old = m_name + ".old";
+  if (not std::filesystem::exists( m_name ) && std::filesystem::exists( old ))
+    std::filesystem::rename( old, m_name );
+
+  setup_indexer( m_indexer, m_stemmer );
+  m_parser.set_stemmer( m_stemmer );
+  m_parser.set_stemming_strategy( Xapian::QueryParser::STEM_SOME );
+  m_parser.add_rangeprocessor(
+    (new Xapian::NumberRangeProcessor( PRICE_SLOT, "price:" ))->release() );
+  m_schema.configure( m_parser );
+  open();
+  // a database without index schema stored was indexed with the default one
+  auto stored = m_writer.get_metadata( "index_schema" );
+  if (stored.empty()) stored = IndexSchema().serialize();
+  if (schema_version() < DB_SCHEMA_VERSION ||
+      (stored != m_schema.serialize() && m_writer.get_doccount()))
+  {
+    upgrade();
+  } else if (stored != m_writer.get_metadata( "index_schema" ) ||
+             m_writer.get_metadata( "schema" ).empty())
+  {
+    // record versions of an empty database, so documents added later are not
+    // taken to be at version 0 and reindexed when the database is reopened
+    m_writer.set_metadata( "schema", std::to_string( DB_SCHEMA_VERSION ) );
+    m_writer.set_metadata( "index_schema", m_schema.serialize() );
+    commit();
+  }
+}
+
+Database::Database( Database& primary, View ) :
+  m_name( primary.name() ),
+  m_writer(),
+  m_reader(),
+  m_stemmer( "english" ),
+  m_indexer(),
+  m_parser(),
+  m_index_threads( 1 ),
+  m_batch_docs( primary.batch_docs() ),
+  m_batch_bytes( primary.batch_bytes() ),
+  m_list_chunk( primary.list_chunk() ),
+  m_cache( 0, 0 ),
+  m_schema( primary.schema() ),
+  m_indexed_docs( 0 ),
+  m_index_seconds( 0.0 ),
+  m_compact_interval( 0.0 ),
+  m_compact_churn( 0.0 ),
+  m_tombstone_horizon( primary.tombstone_horizon() ),
+  m_churn( 0 ),
+  m_compacted(),
+  m_compact_start(),
+  m_compact_before( 0 ),
+  m_compact_rounds( 0 ),
+  m_compaction(),
+  m_compact_report(),
+  m_primary( &primary ),
+  m_generation( primary.m_generation.load() )
+// *****************************************************************************
+//  Constructor: open read-only view of a database owned by another thread
+//! \param[in] primary Database owned by the (db) thread that writes it
+//! \details The view only opens a reader, configured the same way as that of
+//!   the primary, and shares the primary's query cache. It must be constructed
+//!   after the primary has created and upgraded the database, and used only
+//!   for queries and lookups.
+// *****************************************************************************
+{
+  m_parser.set_stemmer( m_stemmer );
+  m_parser.set_stemming_strategy( Xapian::QueryParser::STEM_SOME );
+  m_parser.add_rangeprocessor(
+    (new Xapian::NumberRangeProcessor( PRICE_SLOT, "price:" ))->release() );
+  m_schema.configure( m_parser );
+  open();
+}
+
+void
+Database::open()
+// *****************************************************************************
+//  (Re)open database handles
+// *****************************************************************************
+{
+  if (not m_primary)
+    m_writer = Xapian::WritableDatabase( m_name, Xapian::DB_CREATE_OR_OPEN );
+  m_reader = Xapian::Database( m_name );
+  m_parser.set_database( m_reader );
+}
+
+const Xapian::Database&
+Database::reader()
+// *****************************************************************************
+//  Reader handle, reopened if the database has changed since last opened
+//! \return Reader handle at the latest committed revision
+//! \details A read-only view has no writer to compare revisions with, so it
+//!   reopens the reader, which is a no-op if the revision has not changed, and
+//!   opens the database anew once the primary has replaced it. If the primary
+//!   is in the middle of swapping the database directories, opening fails and
+//!   is retried until the swap is done.
+// *****************************************************************************
+{
+  if (m_primary) {
+    bool replaced = false;
+    for (int tries = 1; ; ++tries) {
+      auto generation = m_primary->m_generation.load();
+      try {
+        if (replaced || generation != m_generation) {
+          open();
+          m_generation = generation;
+          MDEBUG( "Opened replaced db at revision " << m_reader.get_revision() );
+        } else if (m_reader.reopen()) {
+          MDEBUG( "Reopened db at revision " << m_reader.get_revision() );
+        }
+        break;
+      } catch ( const Xapian::DatabaseOpeningError& ) {
+        if (tries == MAX_VIEW_OPEN_TRIES) throw;
+      } catch ( const Xapian::DatabaseModifiedError& ) {
+        if (tries == MAX_VIEW_OPEN_TRIES) throw;
+      }
+      replaced = true;
+      std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+  } else if (m_reader.get_revision() != m_writer.get_revision()) {
+    m_reader.reopen();
+    MDEBUG( "Reopened db at revision " << m_reader.get_revision() );
+  }
+  return m_reader;
+}
+
+void
+Database::commit()
+// *****************************************************************************
+//  Commit pending changes to database
+//! \details Explicitly commit so that we get to see any errors.
+//!   WritableDatabase's destructor would commit implicitly (unless we're in a
+//!   transaction) but would swallow any exceptions produced.
+// *****************************************************************************
+{
+  m_writer.commit();
+}
+
+void
+Database::merge( const std::vector< std::string >& dbs )
+// *****************************************************************************
+//  Merge databases into this database
+//! \param[in] dbs Names of Xapian databases to merge into this one
+//! \details All databases are compacted into a new database alongside this
+//!   one, which then replaces this database. The documents in the databases
+//!   merged must be distinct. The merged databases all number their documents
+//!   from 1, so they cannot keep their document ids and compaction renumbers
+//!   them. This invalidates document ids handed out as list cursors, so the
+//!   numbering recorded in the metadata is bumped, which makes listing reject
+//!   cursors taken before the merge instead of skipping or repeating
+//!   documents.
+// *****************************************************************************
+{
+  commit();
+  auto next = std::to_string( numbering() + 1 );
+  auto tmp = m_name + ".merge";
+  std::filesystem::remove_all( tmp );
+  Xapian::Database all( m_name );
+  for (const auto& d : dbs) all.add_database( Xapian::Database( d ) );
+  all.compact( tmp );
+  all.close();
+  replace( tmp );
+  m_writer.set_metadata( "numbering", next );
+  commit();
+}
+
+unsigned long
+Database::numbering()
+// *****************************************************************************
+//  Number of times document ids have been renumbered by merging
+//! \return Numbering of document ids, 0 if never renumbered
+//! \details Document ids handed out are only valid within the same numbering.
+// *****************************************************************************
+{
+  unsigned long n = 0;
+  auto v = reader().get_metadata( "numbering" );
+  return to_number( v, n ) ? n : 0;
+}
+
+void
+Database::replace( const std::string& dir )
+// *****************************************************************************
+//  Replace this database with another one, e.g., a merged or compacted one
+//! \param[in] dir Directory of the Xapian database to replace this one with
+//! \details The database directories are swapped via renames so that the
+//!   handles are closed only for the duration of the swap. If the swap fails,
+//!   the previous database is put back and reopened before rethrowing, so the
+//!   handles remain usable. If interrupted, the constructor recovers the
+//!   previous database. The generation is bumped before the handles are closed
+//!   and again once the swap is done, so read-only views reopen the database
+//!   instead of reading through handles to the one replaced.
+// *****************************************************************************
+{
+  ++m_generation;
+  m_writer.close();
+  m_reader.close();
+  auto old = m_name + ".old";
+  try {
+    std::filesystem::remove_all( old );
+    std::filesystem::rename( m_name, old );
+    std::filesystem::rename( dir, m_name );
+    open();
+  } catch (...) {
+    if (std::filesystem::exists( old )) {
+      std::filesystem::remove_all( m_name );
+      std::filesystem::rename( old, m_name );
+    }
+    open();
+    ++m_generation;
+    throw;
+  }
+  ++m_generation;
+  std::filesystem::remove_all( old );
+}
+
+piac::QueryCache::QueryCache( std::size_t max_entries, std::size_t max_bytes ) :
+  m_max_entries( max_entries ),
+  m_max_bytes( max_bytes ),
+  m_generation( 0 ),
+  m_revision( 0 ),
+  m_lru(),
+  m_map(),
+  m_bytes( 0 ),
+  m_hits( 0 ),
+  m_misses( 0 ),
+  m_evictions( 0 ),
+  m_invalidations( 0 )
+// *****************************************************************************
+//  Constructor
+//! \param[in] max_entries Maximum number of entries to cache
+//! \param[in] max_bytes Maximum number of bytes of keys and results to cache
+// *****************************************************************************
+{
+}
+
+void
+piac::QueryCache::limits( std::size_t max_entries, std::size_t max_bytes )
+// *****************************************************************************
+//  Configure limits, zero entries disables the cache
+//! \param[in] max_entries Maximum number of entries to cache
+//! \param[in] max_bytes Maximum number of bytes of keys and results to cache
+// *****************************************************************************
+{
+  std::lock_guard lock( m_mutex );
+  m_max_entries = max_entries;
+  m_max_bytes = max_bytes;
+  evict();
+}
+
+void
+piac::QueryCache::revise( unsigned generation, Xapian::rev revision )
+// *****************************************************************************
+//  Drop all entries if generation or revision differs from the cached
+//! \param[in] generation Database generation to compare to
+//! \param[in] revision Database revision to compare to
+// *****************************************************************************
+{
+  if (generation == m_generation && revision == m_revision) return;
+  if (not m_lru.empty()) ++m_invalidations;
+  m_lru.clear();
+  m_map.clear();
+  m_bytes = 0;
+  m_generation = generation;
+  m_revision = revision;
+}
+
+void
+piac::QueryCache::evict()
+// *****************************************************************************
+//  Drop least-recently-used entries until within limits
+// *****************************************************************************
+{
+  while (not m_lru.empty() &&
+         (m_lru.size() > m_max_entries || m_bytes > m_max_bytes))
+  {
+    const auto& e = m_lru.back();
+    m_bytes -= e.first.size() + e.second.size();
+    m_map.erase( e.first );
+    m_lru.pop_back();
+    ++m_evictions;
+  }
+}
+
+bool
+piac::QueryCache::find( unsigned generation,
+                        Xapian::rev revision,
+                        const std::string& key,
+                        std::string& result )
+// *****************************************************************************
+//  Look up a query result
+//! \param[in] generation Database generation the result is needed at
+//! \param[in] revision Database revision the result is needed at
+//! \param[in] key Key identifying the query and its options
+//! \param[out] result Result cached, copied so it stays valid while other
+//!   query workers modify the cache
+//! \return True if found, false if not cached
+// *****************************************************************************
+{
+  std::lock_guard lock( m_mutex );
+  if (m_max_entries == 0) return false;
+  revise( generation, revision );
+  auto it = m_map.find( key );
+  if (it == end(m_map)) {
+    ++m_misses;
+    return false;
+  }
+  ++m_hits;
+  m_lru.splice( begin(m_lru), m_lru, it->second );
+  result = it->second->second;
+  return true;
+}
+
+void
+piac::QueryCache::insert( unsigned generation,
+                          Xapian::rev revision,
+                          const std::string& key,
+                          const std::string& result )
+// *****************************************************************************
+//  Store a query result
+//! \param[in] generation Database generation the result was computed at
+//! \param[in] revision Database revision the result was computed at
+//! \param[in] key Key identifying the query and its options
+//! \param[in] result Query result to cache
+// *****************************************************************************
+{
+  std::lock_guard lock( m_mutex );
+  if (m_max_entries == 0) return;
+  revise( generation, revision );
+  auto size = key.size() + result.size();
+  if (size > m_max_bytes || m_map.find( key ) != end(m_map)) return;
+  m_lru.emplace_front( key, result );
+  m_map.emplace( key, begin(m_lru) );
+  m_bytes += size;
+  evict();
+}
+
+std::string
+piac::QueryCache::stats() const
+// *****************************************************************************
+//  Return statistics on cache use
+//! \return String containing cache limits and counters
+// *****************************************************************************
+{
+  std::lock_guard lock( m_mutex );
+  auto lookups = m_hits + m_misses;
+  std::stringstream s;
+  s << "Query cache: entries: " << m_lru.size() << '/' << m_max_entries
+    << ", bytes: " << m_bytes << '/' << m_max_bytes
+    << ", hits: " << m_hits << ", misses: " << m_misses
+    << ", hit rate: " << std::fixed << std::setprecision( 1 )
+    << (lookups ? 100.0 * static_cast< double >( m_hits ) /
+                  static_cast< double >( lookups ) : 0.0) << '%'
+    << ", evictions: " << m_evictions
+    << ", invalidations: " << m_invalidations;
+  return s.str();
+}
+
+unsigned
+Database::schema_version()
+// *****************************************************************************
+//  Version of the layout of terms and values of the database
+//! \return Schema version stored in the database metadata. An empty database
+//!   is at the current version, a database without it is at version 0.
+// *****************************************************************************
+{
+  auto v = m_writer.get_metadata( "schema" );
+  if (not v.empty()) return static_cast< unsigned >( std::stoul( v ) );
+  return m_writer.get_doccount() ? 0 : DB_SCHEMA_VERSION;
+}
+
+void
+Database::upgrade()
+// *****************************************************************************
+//  Reindex all documents to the current schema version and index schema
+//! \details Terms and values are recomputed from the document data stored
+//!   and author aggregates are rebuilt. Document ids and the time documents
+//!   were added, if known, are kept. Changes are committed
+//!   every batch_docs() documents. If interrupted, the upgrade is redone from
+//!   scratch on next open, which is fine since it is idempotent.
+// *****************************************************************************
+{
+  MINFO( "Upgrading db " << m_name << " from schema version "
+         << schema_version() << " to " << DB_SCHEMA_VERSION << ", "
+         << m_writer.get_doccount() << " documents, index schema: "
+         << m_schema.summary() );
+  auto start = std::chrono::steady_clock::now();
+  std::vector< Xapian::docid > ids;
+  for (auto it = m_writer.postlist_begin( {} );
+       it != m_writer.postlist_end( {} ); ++it)
+  {
+    ids.push_back( *it );
+  }
+  std::unordered_map< std::string, AuthorStats > authors;
+  std::size_t n = 0;
+  for (auto id : ids) {
+    auto old = m_writer.get_document( id );
+    Document ndoc;
+    ndoc.deserialize( old.get_data() );
+    auto time = old.get_value( TIME_SLOT );
+    auto q = old.termlist_begin();
+    q.skip_to( "Q" );
+    Xapian::Document doc;
+    m_schema.index( m_indexer, doc, ndoc );
+    add_values( doc, ndoc );
+    if (not time.empty()) doc.add_value( TIME_SLOT, time );
+    doc.add_boolean_term( std::to_string( ndoc.id() ) );
+    doc.set_data( old.get_data() );
+    if (q != old.termlist_end() && (*q)[0] == 'Q') doc.add_term( *q );
+    if (not ndoc.author().empty()) {
+      doc.add_boolean_term( 'A' + ndoc.author() );
+      auto& a = authors[ ndoc.author() ];
+      ++a.ads;
+      if (not time.empty())
+        a.newest = std::max( a.newest, Xapian::sortable_unserialise( time ) );
+    }
+    m_writer.replace_document( id, doc );
+    if (++n % m_batch_docs == 0) commit();
+  }
+  for (const auto& [author, a] : authors) {
+    m_writer.set_metadata( 'A' + author, std::to_string( a.ads ) + ' ' +
+                                         std::to_string( a.newest ) );
+  }
+  m_writer.set_metadata( "schema", std::to_string( DB_SCHEMA_VERSION ) );
+  m_writer.set_metadata( "index_schema", m_schema.serialize() );
+  commit();
+  std::chrono::duration< double > elapsed =
+    std::chrono::steady_clock::now() - start;
+  MINFO( "Upgraded " << n << " documents in " << elapsed.count() << " s" );
+}
+
+std::string
+Database::stats()
+// *****************************************************************************
+//  Report index size, indexing throughput and index schema
+//! \return Report of number of documents, document length, number of distinct
+//!   terms, size on disk, indexing throughput since opened, and index schema
+//! \details Counting distinct terms walks the whole term list so it is linear
+//!   in the size of the vocabulary; this is meant for operators comparing
+//!   index schemas, not for frequent use.
+// *****************************************************************************
+{
+  const auto& r = reader();
+  Xapian::termcount terms = 0;
+  for (auto t = r.allterms_begin(); t != r.allterms_end(); ++t) ++terms;
+  auto bytes = disk_size( m_name );
+  std::stringstream s;
+  s << "Number of documents: " << r.get_doccount()
+    << ", total length: " << r.get_total_length()
+    << ", average length: " << std::fixed << std::setprecision( 1 )
+    << r.get_avlength()
+    << ", distinct terms: " << terms
+    << ", size on disk: " << bytes << " bytes"
+    << ", bytes/doc: " << std::setprecision( 0 )
+    << (r.get_doccount() ? static_cast< double >( bytes ) /
+                           static_cast< double >( r.get_doccount() ) : 0.0)
+    << ", indexed: " << m_indexed_docs << " docs in " << std::setprecision( 3 )
+    << m_index_seconds << " s (" << std::setprecision( 0 )
+    << static_cast< double >( m_indexed_docs ) /
+       std::max( m_index_seconds, 1.0e-9 ) << " docs/sec)"
+    << "\nIndex schema: " << m_schema.summary();
+  if (not m_compact_report.empty()) s << '\n' << m_compact_report;
+  return s.str();
+}
+
+bool
+Database::compact()
+// *****************************************************************************
+//  Start compacting the database in the background
+//! \return True if compaction started, false if already in progress
+//! \details The database is compacted by a background thread into a fresh
+//!   directory alongside this one from a snapshot at the latest revision,
+//!   while this thread keeps reading and writing the database. maintain()
+//!   swaps the compacted copy in once it is done and up to date.
+// *****************************************************************************
+{
+  if (m_compaction.valid()) return false;
+  commit();
+  MINFO( "Compacting db " << m_name );
+  m_compact_start = std::chrono::steady_clock::now();
+  m_compact_before = disk_size( m_name );
+  m_compact_rounds = 0;
+  m_churn = 0;
+  m_compaction = std::async( std::launch::async,
+    []( std::string name, std::string tmp ){
+      std::filesystem::remove_all( tmp );
+      Xapian::Database live( name );
+      auto rev = live.get_revision();
+      live.compact( tmp, Xapian::DBCOMPACT_NO_RENUMBER );
+      live.close();
+      return catch_up( name, tmp, rev );
+    }, m_name, m_name + ".compact" );
+  return true;
+}
+
+std::string
+Database::maintain()
+// *****************************************************************************
+//  Run scheduled maintenance, call periodically from the db thread
+//! \return Report of maintenance done, empty if none
+//! \details Starts compaction if compact_interval() seconds have passed since
+//!   the last one and the database has changed, or if the number of documents
+//!   added and removed since the last one exceeds compact_churn() times the
+//!   number of documents. Once the background compaction is done, the
+//!   compacted copy is swapped in if the database has not changed in the
+//!   meantime, otherwise the copy is brought up to date again in the
+//!   background, so this thread only ever blocks for the swap. As this
+//!   commits pending changes, it must not be called while changes are left
+//!   uncommitted on purpose, e.g., by a group commit.
+// *****************************************************************************
+{
+  using clock = std::chrono::steady_clock;
+  auto tmp = m_name + ".compact";
+
+  if (m_compaction.valid()) {
+    if (m_compaction.wait_for( std::chrono::seconds( 0 ) ) !=
+        std::future_status::ready)
+    {
+      return {};
+    }
+    ++m_compact_rounds;
+    try {
+      auto rev = m_compaction.get();
+      commit();   // so that changes not yet committed are caught up as well
+      if (rev != m_writer.get_revision()) {
+        m_compaction = std::async( std::launch::async, catch_up, m_name, tmp,
+                                   rev );
+        return {};
+      }
+      auto swap = clock::now();
+      replace( tmp );
+      m_compacted = clock::now();
+      std::chrono::duration< double > elapsed = m_compacted - m_compact_start;
+      std::chrono::duration< double, std::milli > swapped = m_compacted - swap;
+      std::stringstream s;
+      s << "Compacted db in " << std::fixed << std::setprecision( 3 )
+        << elapsed.count() << " s (" << m_compact_rounds << " rounds, swap "
+        << swapped.count() << " ms), size on disk: " << m_compact_before
+        << " -> " << disk_size( m_name ) << " bytes";
+      m_compact_report = s.str();
+    } catch ( const Xapian::Error& e ) {
+      std::filesystem::remove_all( tmp );
+      m_compacted = clock::now();
+      m_compact_report = "Compaction failed: " + e.get_description();
+    } catch ( const std::exception& e ) {
+      std::filesystem::remove_all( tmp );
+      m_compacted = clock::now();
+      m_compact_report = std::string( "Compaction failed: " ) + e.what();
+    }
+    return m_compact_report;
+  }
+
+  std::chrono::duration< double > since = clock::now() - m_compacted;
+  if ((m_compact_interval > 0.0 && since.count() >= m_compact_interval &&
+       m_churn > 0) ||
+      (m_compact_churn > 0.0 && m_churn >= MIN_COMPACT_CHURN &&
+       static_cast< double >( m_churn ) >=
+         m_compact_churn * static_cast< double >( m_writer.get_doccount() )))
+  {
+    compact();
+  }
+  return {};
+}
+
+piac::AuthorStats
+Database::author_stats( const std::string& author )
+// *****************************************************************************
+//  Aggregates of documents of an author
+//! \param[in] author Author whose aggregates to return
+//! \return Aggregates of the author's documents, zero if none
+// *****************************************************************************
+{
+  AuthorStats a;
+  std::stringstream s( m_primary ? reader().get_metadata( 'A' + author )
+                                 : m_writer.get_metadata( 'A' + author ) );
+  s >> a.ads >> a.newest;
+  return a;
+}
+
+void
+Database::tombstone( const Tombstone& t )
+// *****************************************************************************
+//  Record tombstone of a document deleted by its author
+//! \param[in] t Tombstone to record
+//! \details Tombstones are kept in the database metadata, committed together
+//!   with the documents deleted, keyed by 'T' and the hash of the document.
+//!   The author, a binary hash, is stored last, after the time, the address
+//!   and the signature.
+// *****************************************************************************
+{
+  m_writer.set_metadata( 'T' + t.hash, std::to_string( t.time ) + ' ' +
+                         t.address + ' ' + t.signature + ' ' + t.author );
+}
+
+bool
+Database::tombstone( const std::string& hash, Tombstone& t )
+// *****************************************************************************
+//  Look up tombstone of a document
+//! \param[in] hash Hash of document
+//! \param[out] t Tombstone of document if found
+//! \return True if found
+// *****************************************************************************
+{
+  auto v = m_writer.get_metadata( 'T' + hash );
+  if (v.size() < Hash256::SIZE + 2) return false;
+  std::stringstream ss( v.substr( 0, v.size() - Hash256::SIZE ) );
+  t = {};
+  if (not (ss >> t.time)) return false;
+  // address and signature are empty for tombstones recorded unsigned
+  ss >> t.address >> t.signature;
+  t.hash = hash;
+  t.author = v.substr( v.size() - Hash256::SIZE );
+  return true;
+}
+
+std::vector< piac::Tombstone >
+Database::tombstones()
+// *****************************************************************************
+//  All tombstones kept
+//! \return Tombstones kept in the database
+// *****************************************************************************
+{
+  std::vector< Tombstone > all;
+  for (auto k = m_writer.metadata_keys_begin( "T" );
+       k != m_writer.metadata_keys_end( "T" ); ++k)
+  {
+    Tombstone t;
+    if (tombstone( (*k).substr( 1 ), t )) all.push_back( std::move(t) );
+  }
+  return all;
+}
+
+std::vector< std::string >
+Database::expire_tombstones( std::int64_t now )
+// *****************************************************************************
+//  Remove tombstones past their horizon
+//! \param[in] now Current time, seconds since the epoch
+//! \return Hashes of documents whose tombstones were removed
+//! \details Left to the caller to commit.
+// *****************************************************************************
+{
+  std::vector< std::string > expired;
+  for (auto& t : tombstones()) {
+    if (static_cast< double >( now - t.time ) > m_tombstone_horizon) {
+      m_writer.set_metadata( 'T' + t.hash, {} );
+      expired.push_back( std::move(t.hash) );
+    }
+  }
+  return expired;
+}
+
+void
+Database::update_author( const std::string& author,
+                         long long ads,
+                         double time )
+// *****************************************************************************
+//  Update aggregates of an author after documents added or removed
+//! \param[in] author Author whose documents were added or removed
+//! \param[in] ads Number of documents added (positive) or removed (negative)
+//! \param[in] time Time documents were added if added, or the time the newest
+//!   of the documents removed was added if removed
+//! \details Must be called after the documents have been added or removed
+//!   but before committing, so that the aggregates are committed together with
+//!   the documents. Only if the newest document of the author is removed are
+//!   the times of the author's remaining documents looked at.
+// *****************************************************************************
+{
+  if (author.empty() || ads == 0) return;
+  m_churn += static_cast< std::size_t >( std::abs( ads ) );
+  auto a = author_stats( author );
+  auto n = static_cast< long long >( a.ads ) + ads;
+  if (n <= 0) {
+    m_writer.set_metadata( 'A' + author, {} );
+    return;
+  }
+  a.ads = static_cast< Xapian::doccount >( n );
+  if (ads > 0) {
+    a.newest = std::max( a.newest, time );
+  } else if (time >= a.newest) {
+    a.newest = 0.0;
+    for (auto p = m_writer.postlist_begin( 'A' + author );
+         p != m_writer.postlist_end( 'A' + author ); ++p)
+    {
+      auto t = m_writer.get_document( *p ).get_value( TIME_SLOT );
+      if (not t.empty())
+        a.newest = std::max( a.newest, Xapian::sortable_unserialise( t ) );
+    }
+  }
+  m_writer.set_metadata( 'A' + author, std::to_string( a.ads ) + ' ' +
+                                       std::to_string( a.newest ) );
+}
+
 Xapian::doccount
-piac::get_doccount( const std::string db_name )
+piac::get_doccount( Database& db )
 // *****************************************************************************
 //  Get number of documents in Xapian database
-//! \param[in] db_name Name of Xapian db to operate on
+//! \param[in,out] db Xapian database to operate on
 //! \return Number of documents in database
 // *****************************************************************************
 {
   try {
-    Xapian::Database db( db_name );
-    return db.get_doccount();
+    return db.reader().get_doccount();
   } catch ( const Xapian::Error &e ) {
     MWARNING( e.get_description() );
   }
   return {};
 }
 
+void
+piac::add_values( Xapian::Document& doc, const Document& ndoc )
+// ****************************************************************************
+//  Add value slots of a document
+//! \param[in,out] doc Xapian document to add values to
+//! \param[in] ndoc Json document to take values from
+// ****************************************************************************
+{
+  doc.add_value( PRICE_SLOT, Xapian::sortable_serialise( ndoc.price() ) );
+  doc.add_value( CATEGORY_SLOT, ndoc.category() );
+  doc.add_value( CONDITION_SLOT, ndoc.condition() );
+  doc.add_value( LOCATION_SLOT, ndoc.location() );
+  doc.add_value( FORMAT_SLOT, ndoc.format() );
+}
+
 std::string
 piac::add_document( const std::string& author,
+                    const IndexSchema& schema,
                     Xapian::TermGenerator& indexer,
                     Xapian::WritableDatabase& db,
                     Document& ndoc )
 // ****************************************************************************
 //  Add document to Xapian database
 //! \param[in] author Author of the database document
+//! \param[in] schema Index schema configuring how document fields are indexed
 //! \param[in,out] indexer Xapian indexer to use for database indexing
 //! \param[in,out] db Xapian database object to add document to
 //! \param[in,out] ndoc Json document to add
@@ -47,43 +944,44 @@ piac::add_document( const std::string& author,
 // ****************************************************************************
 {
   assert( not author.empty() );
-  Xapian::Document doc;
-  indexer.set_document( doc );
-  // Index each field with a suitable prefix
-  indexer.index_text( ndoc.title(), 1, "S" );
-  indexer.index_text( ndoc.description(), 1, "XD" );
-  indexer.index_text( ndoc.category(), 1, "XC" );
-  indexer.index_text( ndoc.condition(), 1, "XO" );
-  indexer.index_text( ndoc.shipping(), 1, "XS" );
-  indexer.index_text( ndoc.format(), 1, "XF" );
-  indexer.index_text( ndoc.location(), 1, "XL" );
-  indexer.index_text( ndoc.keywords(), 1, "K" );
-  // Index fields without prefixes for general search
-  indexer.index_text( ndoc.title() );
-  indexer.increase_termpos();
-  indexer.index_text( ndoc.description() );
-  indexer.increase_termpos();
-  indexer.index_text( ndoc.category() );
-  indexer.increase_termpos();
-  indexer.index_text( ndoc.condition() );
-  indexer.increase_termpos();
-  indexer.index_text( ndoc.shipping() );
-  indexer.increase_termpos();
-  indexer.index_text( ndoc.format() );
-  indexer.increase_termpos();
-  indexer.index_text( ndoc.location() );
-  indexer.increase_termpos();
-  indexer.index_text( ndoc.keywords() );
-  // Add value fields
-  doc.add_value( 1, std::to_string( ndoc.price() ) );
   // Generate a hash of the doc fields and store it in the document
   ndoc.author( author );
   auto entry = ndoc.serialize();
   ndoc.sha( sha256( entry ) );
-  auto sha = ndoc.sha();
+  return add_document( schema, indexer, db, ndoc, entry, ndoc.sha() );
+}
+
+std::string
+piac::add_document( const IndexSchema& schema,
+                    Xapian::TermGenerator& indexer,
+                    Xapian::WritableDatabase& db,
+                    const Document& ndoc,
+                    const std::string& entry,
+                    const std::string& sha )
+// ****************************************************************************
+//  Add document already serialized and hashed to Xapian database
+//! \param[in] schema Index schema configuring how document fields are indexed
+//! \param[in,out] indexer Xapian indexer to use for database indexing
+//! \param[in,out] db Xapian database object to add document to
+//! \param[in] ndoc Json document to add, with its author set
+//! \param[in] entry Serialized document, stored as the document data
+//! \param[in] sha Hash of entry
+//! \return Hash of the document added
+//! \details Used when the serialized document and its hash are already at
+//!   hand, e.g., received from a peer, so they are not computed again.
+// ****************************************************************************
+{
+  assert( not ndoc.author().empty() && sha.size() == Hash256::SIZE );
+  Xapian::Document doc;
+  // Index text fields as configured by the index schema
+  schema.index( indexer, doc, ndoc );
+  // Add value fields
+  add_values( doc, ndoc );
+  doc.add_value( TIME_SLOT, Xapian::sortable_serialise( now() ) );
   // Ensure each object ends up in the database only once no matter how
   // many times we run the indexer
   doc.add_boolean_term( std::to_string( ndoc.id() ) );
+  doc.add_boolean_term( 'A' + ndoc.author() );
   doc.set_data( entry );
   doc.add_term( 'Q' + sha );
   // Add Xapian doc to db
@@ -91,18 +989,238 @@ piac::add_document( const std::string& author,
   return sha;
 }
 
+namespace piac {
+
+static void
+parallel_for( std::size_t nthreads,
+              std::size_t size,
+              const std::function< void( std::size_t, std::size_t,
+                                         std::size_t ) >& work )
+// *****************************************************************************
+//! Split a range of work into contiguous chunks and run them on threads
+//! \param[in] nthreads Number of threads to use
+//! \param[in] size Size of range of work to split: [0,size)
+//! \param[in] work Function to call with the chunk [begin,end) and thread id
+//! \details An exception thrown by work, e.g., a Xapian::Error, is caught in
+//!   the thread that threw it and, once all threads have been joined, the
+//!   first one is rethrown in the calling thread.
+// *****************************************************************************
+{
+  std::vector< std::thread > threads;
+  std::vector< std::exception_ptr > errors( nthreads );
+  auto chunk = (size + nthreads - 1) / nthreads;
+  for (std::size_t t = 0; t < nthreads; ++t) {
+    auto b = std::min( size, t * chunk );
+    auto e = std::min( size, b + chunk );
+    threads.emplace_back( [&work,&errors,b,e,t](){
+      try {
+        work( b, e, t );
+      } catch (...) {
+        errors[t] = std::current_exception();
+      }
+    } );
+  }
+  for (auto& t : threads) t.join();
+  for (const auto& e : errors) {
+    if (e) std::rethrow_exception( e );
+  }
+}
+
+//! Index documents in parallel into shards to be merged into a database
+//! \details Each thread builds its own temporary Xapian database (shard)
+//!   using its own indexer. The shards are kept open across batches of
+//!   documents, committed after each batch, and merged into the database once
+//!   all batches have been indexed, so the database is rewritten only once.
+//!   Nothing is kept in memory per document indexed: documents already in the
+//!   shards are found via their hash terms and the hashes of the documents
+//!   merged are read from the shards.
+class BulkIndexer {
+  public:
+    //! Constructor: create empty shards
+    BulkIndexer( const std::string& author, Database& db ) :
+      m_author( author ), m_db( db ), m_names(), m_shards(), m_stemmers(),
+      m_indexers(), m_docs( 0 )
+    {
+      for (std::size_t t = 0; t < db.index_threads(); ++t) {
+        m_names.push_back( db.name() + ".shard" + std::to_string( t ) );
+        m_shards.emplace_back( m_names.back(), Xapian::DB_CREATE_OR_OVERWRITE );
+        m_stemmers.emplace_back( "english" );
+      }
+      m_indexers.resize( m_shards.size() );
+      for (std::size_t t = 0; t < m_shards.size(); ++t)
+        setup_indexer( m_indexers[t], m_stemmers[t] );
+    }
+
+    //! Destructor: remove shards
+    ~BulkIndexer() {
+      for (auto& s : m_shards) s.close();
+      for (const auto& d : m_names) std::filesystem::remove_all( d );
+    }
+
+    //! Index a batch of serialized documents with their hashes into the shards
+    void index( const std::vector< Document >& docs,
+                const std::vector< std::string >& entries,
+                const std::vector< std::string >& hashes )
+    {
+      parallel_for( m_shards.size(), docs.size(),
+        [&]( std::size_t b, std::size_t e, std::size_t t ){
+          for (auto i = b; i < e; ++i)
+            add_document( m_db.schema(), m_indexers[t], m_shards[t],
+                          docs[i], entries[i], hashes[i] );
+          m_shards[t].commit();
+        } );
+      m_docs += docs.size();
+    }
+
+    //! Decide if a document has already been indexed into a shard
+    //! \param[in] hash Hash of document
+    bool contains( const std::string& hash ) const {
+      return std::any_of( begin(m_shards), end(m_shards),
+               [&]( const auto& s ){ return s.term_exists( 'Q' + hash ); } );
+    }
+
+    //! Merge shards into database
+    //! \param[in,out] added Hashes of documents merged appended to
+    void merge( std::vector< std::string >& added ) {
+      if (m_docs == 0) return;
+      auto n = added.size();
+      try {
+        for (const auto& s : m_shards) {
+          for (auto q = s.allterms_begin( "Q" ); q != s.allterms_end( "Q" ); ++q)
+            added.push_back( (*q).substr( 1 ) );
+        }
+        for (auto& s : m_shards) s.close();
+        m_db.merge( m_names );
+        m_db.update_author( m_author, static_cast< long long >( m_docs ), now() );
+        m_db.commit();
+      } catch (...) {
+        added.resize( n );
+        throw;
+      }
+      m_docs = 0;
+    }
+
+  private:
+    //! Author of the database documents
+    const std::string& m_author;
+    //! Xapian database to merge shards into
+    Database& m_db;
+    //! Directory names of shards
+    std::vector< std::string > m_names;
+    //! Shards, one per thread
+    std::vector< Xapian::WritableDatabase > m_shards;
+    //! Stemmers, one per thread
+    std::vector< Xapian::Stem > m_stemmers;
+    //! Indexers, one per thread
+    std::vector< Xapian::TermGenerator > m_indexers;
+    //! Number of documents indexed into shards
+    std::size_t m_docs;
+};
+
+static void
+index_batch( const std::string& author,
+             Database& db,
+             std::vector< Document >& docs,
+             const HashSet& my_hashes,
+             std::unique_ptr< BulkIndexer >& bulk,
+             std::vector< std::string >& added )
+// *****************************************************************************
+//! Index a batch of documents into the database
+//! \param[in] author Author of the database documents
+//! \param[in,out] db Xapian database to add documents to
+//! \param[in,out] docs Documents to add
+//! \param[in] my_hashes Hashes to check for duplicates when adding documents
+//! \param[in,out] bulk Shards to index into if not null
+//! \param[in,out] added Hashes of documents committed appended to
+//! \details Documents already in the database, or in the shards, are found
+//!   via their hash terms, so only the hashes of the batch are kept in memory
+//!   to skip duplicates. Without shards, the batch is indexed and committed
+//!   directly into the database in a single transaction, so on error none of
+//!   it is left pending to be committed later. With shards, the batch is
+//!   indexed in parallel into the shards and only appended to added once the
+//!   shards are merged.
+// *****************************************************************************
+{
+  auto nthreads = bulk ? db.index_threads() : 1;
+
+  // serialize and hash documents once, in parallel if worth it
+  std::vector< std::string > entries( docs.size() ), hashes( docs.size() );
+  parallel_for( nthreads, docs.size(),
+    [&]( std::size_t b, std::size_t e, std::size_t ){
+      for (auto i = b; i < e; ++i) {
+        docs[i].author( author );
+        entries[i] = docs[i].serialize();
+        hashes[i] = sha256( entries[i] );
+      }
+    } );
+
+  // select documents we do not yet have, each only once
+  auto& writer = db.writer();
+  HashSet batch;
+  batch.reserve( docs.size() );
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < docs.size(); ++i) {
+    Hash256 h( hashes[i] );
+    if (not my_hashes.contains( h ) && batch.insert( h ) &&
+        not writer.term_exists( 'Q' + hashes[i] ) &&
+        not (bulk && bulk->contains( hashes[i] )))
+    {
+      if (n != i) {
+        docs[n] = std::move( docs[i] );
+        entries[n] = std::move( entries[i] );
+        hashes[n] = std::move( hashes[i] );
+      }
+      ++n;
+    }
+  }
+  docs.resize( n );
+  entries.resize( n );
+  hashes.resize( n );
+  if (docs.empty()) return;
+
+  if (bulk) {
+    bulk->index( docs, entries, hashes );
+  } else {
+    writer.begin_transaction();
+    try {
+      for (std::size_t i = 0; i < n; ++i)
+        add_document( db.schema(), db.indexer(), writer, docs[i],
+                      entries[i], hashes[i] );
+      db.update_author( author, static_cast< long long >( docs.size() ), now() );
+      writer.commit_transaction();
+    } catch ( const Xapian::Error& ) {
+      writer.cancel_transaction();
+      throw;
+    }
+    added.insert( end(added), begin(hashes), end(hashes) );
+  }
+}
+
+} // piac::
+
 std::string
 piac::index_db( const std::string& author,
-                const std::string& db_name,
+                Database& db,
                 const std::string& input_filename,
-                const std::unordered_set< std::string >& my_hashes )
+                std::vector< std::string >& added,
+                const HashSet& my_hashes )
 // ****************************************************************************
 //  Index Xapian database
 //! \param[in] author Author of the database document
-//! \param[in] db_name Name of the Xapian database object
+//! \param[in,out] db Xapian database to add documents to
 //! \param[in] input_filename File to read JSON data from
+//! \param[in,out] added Hashes of documents added appended to
 //! \param[in] my_hashes Hashes to check for duplicates when adding documents
 //! \return Info string showing how many documents have been added
+//! \details The input is parsed as a stream and documents are indexed in
+//!   batches as they are parsed, committing after every Database::batch_docs()
+//!   documents or Database::batch_bytes() bytes of input, so memory use is
+//!   bounded regardless of the size of the input. If the first batch is large
+//!   enough to be worth it, documents are indexed in parallel into shards
+//!   which are merged into the database at the end. Without shards,
+//!   documents committed before an error remain in the database and are
+//!   appended to added. With shards, documents are only added once the shards
+//!   are merged, so on error none of the input indexed into shards is added.
 // ****************************************************************************
 {
   assert( not author.empty() );
@@ -111,83 +1229,367 @@ piac::index_db( const std::string& author,
   if (not f.good()) {
     return "Cannot open database input file: " + input_filename;
   }
+  f.close();
 
   MDEBUG( "Indexing " << input_filename );
-  Xapian::WritableDatabase db( db_name, Xapian::DB_CREATE_OR_OPEN );
-  Xapian::TermGenerator indexer;
-  Xapian::Stem stemmer( "english" );
-  indexer.set_stemmer( stemmer );
-  indexer.set_stemming_strategy( indexer.STEM_SOME_FULL_POS );
-  std::size_t numins = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto numadded = added.size();
+  bool parsed = false;
   try {
-    // Read json db from file
-    Documents ndoc;
-    ndoc.deserializeFromFile( input_filename );
-    // Insert documents we do not yet have from json into xapian db
-    for (auto& d : ndoc.documents()) {
-      d.author( author );
-      auto entry = d.serialize();
-      if (my_hashes.find( sha256( entry ) ) == end(my_hashes)) {
-        add_document( author, indexer, db, d );
-        ++numins;
+    std::vector< Document > batch;
+    std::unique_ptr< BulkIndexer > bulk;
+    bool first = true;
+    std::size_t batch_start = 0, batch_end = 0;
+
+    auto flush = [&](){
+      if (first) {
+        // Index in parallel, worth it for large number of documents
+        if (db.index_threads() > 1 &&
+            batch.size() >= db.index_threads() * MIN_BULK_DOCS_PER_THREAD)
+        {
+          bulk = std::make_unique< BulkIndexer >( author, db );
+        }
+        first = false;
       }
-    }
-    MDEBUG( "Indexed " << numins << " entries" );
-    // Explicitly commit so that we get to see any errors. WritableDatabase's
-    // destructor will commit implicitly (unless we're in a transaction) but
-    // will swallow any exceptions produced.
-    db.commit();
+      index_batch( author, db, batch, my_hashes, bulk, added );
+      MDEBUG( "Indexed batch of " << batch.size() << " entries, input bytes "
+              << batch_start << '-' << batch_end );
+      batch.clear();
+      batch_start = batch_end;
+    };
+
+    // Read json from file and insert documents in batches as they are parsed
+    parsed = Documents::stream( input_filename,
+      [&]( Document&& d, std::size_t pos ){
+        batch.push_back( std::move(d) );
+        batch_end = pos;
+        if (batch.size() >= db.batch_docs() ||
+            batch_end - batch_start >= db.batch_bytes())
+        {
+          flush();
+        }
+      } );
+    if (not batch.empty()) flush();
+    if (bulk) bulk->merge( added );
+    MDEBUG( "Indexed " << added.size() - numadded << " entries" );
 
   } catch ( const Xapian::Error &e ) {
     MERROR( e.get_description() );
+  } catch ( const std::runtime_error& e ) {
+    MERROR( e.what() );
   }
-  return "Added " + std::to_string( numins ) + " entries";
+
+  auto numins = added.size() - numadded;
+  std::chrono::duration< double > elapsed =
+    std::chrono::steady_clock::now() - start;
+  db.indexed( numins, elapsed.count() );
+  std::stringstream info;
+  info << "Added " << numins << " entries in " << std::fixed
+       << std::setprecision( 3 ) << elapsed.count() << " s ("
+       << std::setprecision( 0 )
+       << static_cast< double >( numins ) / std::max( elapsed.count(), 1.0e-9 )
+       << " docs/sec)";
+  if (not parsed) info << ", error parsing " << input_filename;
+  MINFO( info.str() );
+  return info.str();
 }
 
+namespace piac {
+
+//! Value slots of document fields facets can be counted for
+static const std::map< std::string, Xapian::valueno > g_facet_slots{
+  { "category", CATEGORY_SLOT },
+  { "condition", CONDITION_SLOT },
+  { "location", LOCATION_SLOT },
+  { "format", FORMAT_SLOT } };
+
+//! Largest offset, limit, or number of matches a query can ask for
+static const long long g_max_doccount =
+  std::numeric_limits< Xapian::doccount >::max();
+
+} // piac::
+
+std::string
+piac::parse_query_options( std::string& cmd, QueryOptions& opt )
+// *****************************************************************************
+//  Parse query options from the front of a query command
+//! \param[in,out] cmd Query command, options removed on return
+//! \param[in,out] opt Query options parsed
+//! \return Error message, empty if options are valid
+// *****************************************************************************
+{
+  static const std::unordered_set< std::string > fields{
+    "id", "title", "author", "description", "price", "category", "condition",
+    "shipping", "format", "location", "keywords", "hash" };
+
+  std::stringstream ss( cmd );
+  std::string o;
+  std::streampos rest = 0;
+  while (ss >> o && o.size() > 2 && o[0] == '-' && o[1] == '-') {
+    if (o == "--json") {
+      opt.json = true;
+    } else if (o == "--offset" || o == "--limit") {
+      long long n = -1;
+      if (not (ss >> n) || n < 0 || n > g_max_doccount)
+        return "db query: invalid " + o;
+      auto v = static_cast< Xapian::doccount >( n );
+      if (o == "--offset") opt.offset = v; else opt.limit = v;
+    } else if (o == "--sort") {
+      if (not (ss >> opt.sort) || (opt.sort != "price" && opt.sort != "-price"))
+        return "db query: --sort must be price or -price";
+    } else if (o == "--facets") {
+      std::string f;
+      if (not (ss >> f)) return "db query: missing --facets";
+      std::stringstream fs( f );
+      opt.facets.clear();
+      while (std::getline( fs, f, ',' )) {
+        if (g_facet_slots.find( f ) == end(g_facet_slots))
+          return "db query: no facet " + f;
+        opt.facets.push_back( f );
+      }
+    } else if (o == "--facet-top" || o == "--facet-check") {
+      long long n = -1;
+      if (not (ss >> n) || n <= 0 || n > g_max_doccount)
+        return "db query: invalid " + o;
+      if (o == "--facet-top")
+        opt.facet_top = static_cast< std::size_t >( n );
+      else
+        opt.facet_check = static_cast< Xapian::doccount >( n );
+    } else if (o == "--fields") {
+      std::string f;
+      if (not (ss >> f)) return "db query: missing --fields";
+      std::stringstream fs( f );
+      opt.fields.clear();
+      while (std::getline( fs, f, ',' )) {
+        if (fields.find( f ) == end(fields)) return "db query: no field " + f;
+        opt.fields.push_back( f );
+      }
+    } else {
+      return "db query: unknown option " + o;
+    }
+    rest = ss.eof() ? static_cast< std::streampos >( cmd.size() ) : ss.tellg();
+  }
+  opt.limit = std::min( opt.limit, MAX_QUERY_LIMIT );
+  opt.facet_top = std::min< std::size_t >( opt.facet_top, MAX_QUERY_LIMIT );
+  cmd.erase( 0, static_cast< std::size_t >( rest ) );
+  trim( cmd );
+  return {};
+}
+
+namespace piac {
+
+static void
+project( rapidjson::Writer< rapidjson::StringBuffer >& writer,
+         const Xapian::Document& doc,
+         const std::vector< std::string >& fields )
+// *****************************************************************************
+//! Write selected fields of a database document as a JSON object
+//! \param[in,out] writer JSON writer to write to
+//! \param[in] doc Xapian document whose fields to write
+//! \param[in] fields Document fields to write, "hash" taken from the Q term
+//! \details The document data is only read and parsed if a field other than
+//!   the hash is requested. Hashes and author are written hex-encoded.
+// *****************************************************************************
+{
+  rapidjson::Document data;
+  for (const auto& f : fields) {
+    if (f == "hash") continue;
+    auto d = doc.get_data();
+    data.Parse( d.data(), d.size() );
+    break;
+  }
+
+  writer.StartObject();
+  for (const auto& f : fields) {
+    if (f == "hash") {
+      auto t = doc.termlist_begin();
+      t.skip_to( "Q" );
+      if (t == doc.termlist_end() || (*t)[0] != 'Q') continue;
+      writer.Key( "hash" );
+      writer.String( hex( (*t).substr( 1 ) ).c_str() );
+    } else if (data.IsObject()) {
+      auto m = data.FindMember( f.c_str() );
+      if (m == data.MemberEnd()) continue;
+      writer.Key( f.c_str() );
+      if (f == "author")
+        writer.String( hex( std::string( m->value.GetString(),
+                                         m->value.GetStringLength() ) ).c_str() );
+      else
+        m->value.Accept( writer );
+    }
+  }
+  writer.EndObject();
+}
+
+static std::string
+run_query( Database& db, const std::string& cmd, const QueryOptions& opt )
+// *****************************************************************************
+//! Query Xapian database
+//! \param[in,out] db Xapian database to query
+//! \param[in] cmd Query string
+//! \param[in] opt Query options
+//! \return Result of the database query
+// *****************************************************************************
+{
+  // Parse the query string to produce a Xapian::Query object
+  Xapian::Query query = db.parser().parse_query( cmd );
+  // Start an enquire session
+  Xapian::Enquire enquire( db.reader() );
+  MDEBUG( "parsed query: '" << query.get_description() << "'" );
+  enquire.set_query( query );
+  if (not opt.sort.empty()) {
+    enquire.set_sort_by_value_then_relevance( PRICE_SLOT,
+                                              /* reverse = */ opt.sort[0]=='-' );
+  }
+  // Count facet values while matching, examining a bounded number of matches
+  std::vector< std::unique_ptr< Xapian::ValueCountMatchSpy > > spies;
+  for (const auto& f : opt.facets) {
+    spies.push_back(
+      std::make_unique< Xapian::ValueCountMatchSpy >( g_facet_slots.at(f) ) );
+    enquire.add_matchspy( spies.back().get() );
+  }
+  // sum in 64 bits so that large offsets and limits do not wrap around
+  auto check = spies.empty() ? 0 : static_cast< Xapian::doccount >(
+    std::min< long long >( g_max_doccount,
+      static_cast< long long >( opt.offset ) + opt.limit + opt.facet_check ) );
+  // Find the page of results requested
+  Xapian::MSet matches = enquire.get_mset( opt.offset, opt.limit, check );
+  auto nr = matches.get_matches_estimated();
+  MDEBUG( "got estimated matches: " << nr );
+  auto fields = opt.fields;
+  if (opt.json && fields.empty()) {
+    fields = { "hash", "id", "title", "author", "description", "price",
+               "category", "condition", "shipping", "format", "location",
+               "keywords" };
+  }
+  if (fields.empty() ||
+      std::any_of( begin(fields), end(fields),
+                   []( const std::string& f ){ return f != "hash"; } ))
+  {
+    matches.fetch();  // prefetch documents on page
+  }
+
+  // Construct the results
+  if (opt.json) {
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer< rapidjson::StringBuffer > writer( sb );
+    writer.StartObject();
+    writer.Key( "total" );  writer.Uint( nr );
+    writer.Key( "offset" ); writer.Uint( opt.offset );
+    writer.Key( "limit" );  writer.Uint( opt.limit );
+    if (not spies.empty()) {
+      writer.Key( "facets" );
+      writer.StartObject();
+      writer.Key( "examined" ); writer.Uint64( spies.front()->get_total() );
+      for (std::size_t f = 0; f < spies.size(); ++f) {
+        writer.Key( opt.facets[f].c_str() );
+        writer.StartArray();
+        for (auto t = spies[f]->top_values_begin( opt.facet_top );
+             t != spies[f]->top_values_end( opt.facet_top ); ++t)
+        {
+          writer.StartObject();
+          writer.Key( "value" ); writer.String( (*t).c_str() );
+          writer.Key( "count" ); writer.Uint( t.get_termfreq() );
+          writer.EndObject();
+        }
+        writer.EndArray();
+      }
+      writer.EndObject();
+    }
+    writer.Key( "results" );
+    writer.StartArray();
+    for (auto i = matches.begin(); i != matches.end(); ++i) {
+      writer.StartObject();
+      writer.Key( "rank" );   writer.Uint( i.get_rank() + 1 );
+      writer.Key( "weight" ); writer.Double( i.get_weight() );
+      writer.Key( "doc" );
+      project( writer, i.get_document(), fields );
+      writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return sb.GetString();
+  }
+
+  std::stringstream result;
+  result << nr << " results found.";
+  if (not spies.empty()) {
+    result << "\nfacets, " << spies.front()->get_total()
+           << " matches examined:";
+    for (std::size_t f = 0; f < spies.size(); ++f) {
+      result << "\n" << opt.facets[f] << ':';
+      for (auto t = spies[f]->top_values_begin( opt.facet_top );
+           t != spies[f]->top_values_end( opt.facet_top ); ++t)
+      {
+        result << ' ' << *t << " (" << t.get_termfreq() << ')';
+      }
+    }
+  }
+  if (not matches.empty()) {
+    result << "\nmatches " << opt.offset + 1ULL << '-'
+           << opt.offset + 0ULL + matches.size() << ":\n\n";
+    for (auto i = matches.begin(); i != matches.end(); ++i) {
+      result << i.get_rank() + 1 << ": " << i.get_weight() << " docid=" << *i
+             << " [";
+      if (fields.empty()) {
+        result << i.get_document().get_data();
+      } else {
+        rapidjson::StringBuffer sb;
+        rapidjson::Writer< rapidjson::StringBuffer > writer( sb );
+        project( writer, i.get_document(), fields );
+        result << sb.GetString();
+      }
+      result << "]\n";
+    }
+  }
+  return result.str();
+}
+
+} // piac::
+
 [[nodiscard]] std::string
-piac::db_query( const std::string& db_name, std::string&& cmd )
+piac::db_query( Database& db, std::string&& cmd )
 // *****************************************************************************
 //  Query Xapian database
-//! \param[in] db_name Name of the Xapian database object
-//! \param[in,out] cmd Query command
+//! \param[in,out] db Xapian database to query
+//! \param[in,out] cmd Query command, optionally preceded by query options
 //! \return Result of the database query
+//! \details Only the documents on the page of results requested are read and
+//!   only their fields requested are serialized. See QueryOptions. Results
+//!   are cached keyed on the options, the whitespace-normalized query string
+//!   and the database revision, so a commit invalidates the cache.
 // *****************************************************************************
 {
   try {
 
     MDEBUG( "db query: '" << cmd << "'" );
-    // Open the database for searching
-    Xapian::Database db( db_name );
-    // Start an enquire session
-    Xapian::Enquire enquire( db );
-    // Parse the query string to produce a Xapian::Query object
-    Xapian::QueryParser qp;
-    Xapian::Stem stemmer("english");
-    qp.set_stemmer( stemmer );
-    qp.set_database( db );
-    qp.set_stemming_strategy( Xapian::QueryParser::STEM_SOME );
-    Xapian::Query query = qp.parse_query( cmd );
-    MDEBUG( "parsed query: '" << query.get_description() << "'" );
-    // Find the top 10 results for the query
-    enquire.set_query( query );
-    MDEBUG( "set query: '" << query.get_description() << "'" );
-    Xapian::MSet matches = enquire.get_mset( 0, 10 );
-    MDEBUG( "got matches" );
-    // Construct the results
-    auto nr = matches.get_matches_estimated();
-    MDEBUG( "got estimated matches: " << nr );
-    std::stringstream result;
-    result << nr << " results found.";
-    if (nr) {
-      result << "\nmatches 1-" << matches.size() << ":\n\n";
-      for (Xapian::MSetIterator i = matches.begin(); i != matches.end(); ++i) {
-        MDEBUG( "getting match: " << i.get_rank() );
-        result << i.get_rank() + 1 << ": " << i.get_weight() << " docid=" << *i
-                 << " [" << i.get_document().get_data() << "]\n";
-      }
+    QueryOptions opt;
+    auto err = parse_query_options( cmd, opt );
+    if (not err.empty()) return err;
+
+    // Return result from cache if the same query was done at this revision
+    std::stringstream k;
+    k << opt.offset << ' ' << opt.limit << ' ' << opt.json << ' ' << opt.sort
+      << ' ' << opt.facet_top << ' ' << opt.facet_check;
+    for (const auto& f : opt.facets) k << " +" << f;
+    for (const auto& f : opt.fields) k << ' ' << f;
+    std::stringstream words( cmd );
+    k << '\n';
+    for (std::string w; words >> w; ) k << w << ' ';
+    auto key = k.str();
+    // revisions start over once the database is replaced, so the generation
+    // of the handle opened by reader() is part of the key
+    auto revision = db.reader().get_revision();
+    auto generation = db.generation();
+    std::string cached;
+    if (db.cache().find( generation, revision, key, cached )) {
+      MDEBUG( "query cache hit" );
+      return cached;
     }
-    //MDEBUG( "results: " + result.str() );
-    return result.str();
+    auto result = run_query( db, cmd, opt );
+    if (not result.empty())
+      db.cache().insert( generation, revision, key, result );
+    return result;
 
   } catch ( const Xapian::Error &e ) {
     MERROR( e.get_description() );
@@ -196,29 +1598,44 @@ piac::db_query( const std::string& db_name, std::string&& cmd )
 }
 
 [[nodiscard]] std::vector< std::string >
-piac::db_get_docs( const std::string& db_name,
-                   const std::vector< std::string >& hashes )
+piac::db_get_docs( Database& db,
+                   const std::vector< std::string >& hashes,
+                   std::size_t max_bytes,
+                   std::size_t& served )
 // *****************************************************************************
 //  Get documents from Xapian database
-//! \param[in] db_name Name of the Xapian database object
+//! \param[in,out] db Xapian database to get documents from
 //! \param[in] hashes Hashes of database documents to get retrieve
+//! \param[in] max_bytes Stop before the documents would exceed this many bytes,
+//!   but get at least one, 0: no limit
+//! \param[out] served Number of hashes looked up, found or not, in order
 //! \return Result of the database query
 // *****************************************************************************
 {
   std::vector< std::string > docs;
+  std::size_t bytes = 0;
+  served = hashes.size();
   try {
 
-    Xapian::Database db( db_name );
-    Xapian::doccount dbsize = db.get_doccount();
+    const auto& reader = db.reader();
+    Xapian::doccount dbsize = reader.get_doccount();
     if (dbsize == 0) return {};
 
-    for (const auto& h : hashes) {
+    for (std::size_t i = 0; i < hashes.size(); ++i) {
+      const auto& h = hashes[i];
       assert( h.size() == 32 );
-      auto p = db.postlist_begin( 'Q' + h );
-      if (p != db.postlist_end( 'Q' + h ))
-        docs.push_back( db.get_document( *p ).get_data() );
-      else
+      auto p = reader.postlist_begin( 'Q' + h );
+      if (p != reader.postlist_end( 'Q' + h )) {
+        auto doc = reader.get_document( *p ).get_data();
+        if (max_bytes && not docs.empty() && bytes + doc.size() > max_bytes) {
+          served = i;
+          break;
+        }
+        bytes += doc.size();
+        docs.push_back( std::move(doc) );
+      } else {
         MWARNING( "Document not found: " << hex(h) );
+      }
     }
 
   } catch ( const Xapian::Error &e ) {
@@ -229,117 +1646,261 @@ piac::db_get_docs( const std::string& db_name,
   return docs;
 }
 
-std::size_t
-piac::db_put_docs( const std::string& db_name,
-                   const std::vector< std::string >& docs )
+bool
+piac::db_put_docs( Database& db,
+                   const std::vector< std::string >& docs,
+                   const std::vector< std::string >& hashes,
+                   std::vector< std::string >& added,
+                   bool commit )
 // *****************************************************************************
 //  Put documents to Xapian database
-//! \param[in] db_name Name of the Xapian database object
-//! \param[in] docs Documents to insert to Xapian database
-//! \return Number of documents inserted
+//! \param[in,out] db Xapian database to put documents to
+//! \param[in] docs Serialized documents to insert to Xapian database
+//! \param[in] hashes Hashes of docs, computed where the documents were received
+//! \param[in,out] added Hashes of documents inserted appended to
+//! \param[in] commit False to leave committing to the caller, e.g., to commit
+//!   documents put in a burst together
+//! \return False if the documents could not be put, true otherwise
+//! \details Documents are stored as received and only deserialized to index
+//!   their fields, they are not serialized nor hashed again. The documents and
+//!   the aggregates of their authors are put in a single transaction, so on
+//!   error none of them is put. Without commit, the transaction is unflushed,
+//!   so that it does not commit changes pending from earlier calls, but then
+//!   cancelling it discards those as well: if false is returned, none of the
+//!   documents put since the last commit are in the database.
 // *****************************************************************************
 {
+  assert( docs.size() == hashes.size() );
+  std::vector< std::string > put;
   try {
     MDEBUG( "Inserting & indexing " << docs.size() << " new entries" );
-    Xapian::WritableDatabase db( db_name, Xapian::DB_CREATE_OR_OPEN );
-    Xapian::TermGenerator indexer;
-    Xapian::Stem stemmer( "english" );
-    indexer.set_stemmer( stemmer );
-    indexer.set_stemming_strategy( indexer.STEM_SOME_FULL_POS );
 
     // Insert all documents into xapian db
-    for (const auto& d : docs) {
-      Document ndoc;
-      ndoc.deserialize( d );
-      // refuse doc without author
-      auto author = ndoc.author();
-      if (not author.empty()) add_document( author, indexer, db, ndoc );
-    }
-
-    MDEBUG( "Finished indexing " << docs.size() <<
-            " new entries, commit to db" );
-    // Explicitly commit so that we get to see any errors. WritableDatabase's
-    // destructor will commit implicitly (unless we're in a transaction) but
-    // will swallow any exceptions produced.
-    db.commit();
-    return docs.size();
+    auto& writer = db.writer();
+    writer.begin_transaction( /* flushed = */ commit );
+    try {
+      std::unordered_map< std::string, long long > authors;
+      for (std::size_t i = 0; i < docs.size(); ++i) {
+        Document ndoc;
+        ndoc.deserialize( docs[i] );
+        // refuse doc without author
+        const auto& author = ndoc.author();
+        if (not author.empty()) {
+          // only count documents new to the database, not ones replaced
+          bool fresh = not writer.term_exists( 'Q' + hashes[i] );
+          put.push_back(
+            add_document( db.schema(), db.indexer(), writer, ndoc, docs[i],
+                          hashes[i] ) );
+          if (fresh) ++authors[ author ];
+        }
+      }
+      auto time = now();
+      for (const auto& [author, n] : authors) db.update_author( author, n, time );
+      writer.commit_transaction();
+    } catch ( const Xapian::Error& ) {
+      writer.cancel_transaction();
+      throw;
+    }
+
+    MDEBUG( "Finished indexing " << put.size() << " new entries" );
 
   } catch ( const Xapian::Error &e ) {
     MERROR( e.get_description() );
+    return false;
   }
 
-  return 0;
+  added.insert( end(added), begin(put), end(put) );
+  return true;
 }
 
 std::string
 piac::db_rm_docs( const std::string& author,
-                  const std::string& db_name,
+                  Database& db,
                   const std::unordered_set< std::string >& hashes_to_delete,
-                  const std::unordered_set< std::string >& my_hashes )
+                  const std::unordered_map< std::string, Tombstone >& tombs,
+                  std::vector< std::string >& removed,
+                  const HashSet& my_hashes )
 // *****************************************************************************
 //  Remove documents from Xapian database
 //! \param[in] author Author of the database document
-//! \param[in] db_name Name of the Xapian database object
-//! \param[in] hashes_to_delete Hashes of documents to delete
-//! \param[in] my_hashes Hashes to check for duplicates when removing documents
+//! \param[in,out] db Xapian database to remove documents from
+//! \param[in] hashes_to_delete Hex-encoded hashes of documents to delete
+//! \param[in] tombs Tombstones signed by author, keyed by hash of document
+//! \param[in,out] removed Hashes of documents removed appended to
+//! \param[in] my_hashes Hashes to check for duplicates when removing
+//!   documents, empty: look up all hashes to delete in the database
 //! \return Info on number of documents removed
+//! \details Only the hashes requested are looked up. All documents found are
+//!   verified to belong to author, by walking the author's posting list in
+//!   docid order, before any is deleted, and their tombstones are verified to
+//!   be signed by author. If any of them is not, nothing is removed. The
+//!   documents are then deleted in a single transaction, together with
+//!   recording their tombstones.
 // *****************************************************************************
 {
-  std::size_t numrm = 0;
+  std::vector< std::pair< Xapian::docid, std::string > > todo;
   try {
 
-    Xapian::WritableDatabase db( db_name );
-    Xapian::doccount dbsize = db.get_doccount();
+    auto& writer = db.writer();
+    Xapian::doccount dbsize = writer.get_doccount();
     if (dbsize == 0) return "no docs";
 
-    for (const auto& h : my_hashes) {
-      assert( h.size() == 32 );
-      auto p = db.postlist_begin( 'Q' + h );
-      if ( p != db.postlist_end( 'Q' + h ) &&
-           hashes_to_delete.find(hex(h)) != end(hashes_to_delete) )
+    // look up documents of hashes requested
+    for (const auto& hh : hashes_to_delete) {
+      auto h = unhex( hh );
+      if (h.size() != 32) continue;
+      if (not my_hashes.empty() && not my_hashes.contains( Hash256( h ) ))
+        continue;
+      auto p = writer.postlist_begin( 'Q' + h );
+      if (p != writer.postlist_end( 'Q' + h )) todo.emplace_back( *p, h );
+    }
+    if (todo.empty()) return "Removed 0 entries";
+
+    // verify author of all documents found
+    std::sort( begin(todo), end(todo) );
+    auto a = writer.postlist_begin( 'A' + author );
+    for (const auto& [id, h] : todo) {
+      if (a != writer.postlist_end( 'A' + author )) a.skip_to( id );
+      if (a == writer.postlist_end( 'A' + author ) || *a != id) {
+        MDEBUG( "db rm auth: " + hex(author) + " not author of " + hex(h) );
+        return "db rm: author != user";
+      }
+    }
+
+    // verify tombstones of all documents found are signed by author
+    auto now = static_cast< std::int64_t >( std::time( nullptr ) );
+    for (const auto& [id, h] : todo) {
+      auto t = tombs.find( h );
+      if (t == end(tombs) || t->second.author != author ||
+          not signed_by_author( t->second, now, db.tombstone_horizon() ))
       {
-        auto entry = db.get_document( *p ).get_data();
-        Document ndoc;
-        ndoc.deserialize( entry );
-        if (author == ndoc.author()) {
-          MDEBUG( "db rm" + sha256(h) );
-          db.delete_document( 'Q' + h );
-          ++numrm;
-        } else {
-          MDEBUG( "db rm auth: " + hex(author) + " != " + hex(ndoc.author()) );
-          return "db rm: author != user";
-        }
+        MDEBUG( "db rm auth: " + hex(h) + " not signed by author" );
+        return "db rm: not signed by author";
       }
     }
 
+    // delete documents in a single transaction
+    double newest = 0.0;
+    writer.begin_transaction();
+    try {
+      for (const auto& [id, h] : todo) {
+        auto t = writer.get_document( id ).get_value( TIME_SLOT );
+        if (not t.empty())
+          newest = std::max( newest, Xapian::sortable_unserialise( t ) );
+        writer.delete_document( id );
+        db.tombstone( tombs.at( h ) );
+      }
+      db.update_author( author, -static_cast< long long >( todo.size() ),
+                        newest );
+      writer.commit_transaction();
+    } catch ( const Xapian::Error& ) {
+      writer.cancel_transaction();
+      throw;
+    }
+    for (auto& [id, h] : todo) removed.push_back( std::move(h) );
+
   } catch ( const Xapian::Error &e ) {
     if (e.get_description().find("No such file") == std::string::npos)
       MERROR( e.get_description() );
+    return "Removed 0 entries";
   }
 
-  return "Removed " + std::to_string( numrm ) + " entries";
+  return "Removed " + std::to_string( todo.size() ) + " entries";
+}
+
+std::vector< piac::Tombstone >
+piac::db_bury_docs( Database& db,
+                    const std::vector< Tombstone >& tombs,
+                    std::vector< std::string >& removed )
+// *****************************************************************************
+//  Remove documents deleted by their authors at peers
+//! \param[in,out] db Xapian database to remove documents from
+//! \param[in] tombs Tombstones received from peers
+//! \param[in,out] removed Hashes of documents removed appended to
+//! \return Tombstones not yet known and recorded, to pass on to peers
+//! \details A tombstone already known is ignored. Before anything is deleted
+//!   or recorded, a tombstone is verified to be signed by the author it names,
+//!   not to be past its horizon, and not to be dated ahead. If the document is
+//!   in the database, it is only removed, and the tombstone recorded, if its
+//!   author is that of the tombstone. A tombstone of a document not in the
+//!   database is recorded and passed on, and the document's author is checked
+//!   against it if the document arrives later. Tombstones are recorded in a
+//!   single transaction with the documents removed.
+// *****************************************************************************
+{
+  std::vector< Tombstone > fresh;
+  try {
+
+    auto& writer = db.writer();
+    auto now = static_cast< std::int64_t >( std::time( nullptr ) );
+    writer.begin_transaction();
+    try {
+      for (const auto& t : tombs) {
+        Tombstone known;
+        if (t.hash.size() != Hash256::SIZE || db.tombstone( t.hash, known ))
+          continue;
+        if (not signed_by_author( t, now, db.tombstone_horizon() )) {
+          MWARNING( "Tombstone of " << hex(t.hash) << " not signed by author" );
+          continue;
+        }
+        auto p = writer.postlist_begin( 'Q' + t.hash );
+        if (p != writer.postlist_end( 'Q' + t.hash )) {
+          auto id = *p;
+          auto a = writer.postlist_begin( 'A' + t.author );
+          if (a != writer.postlist_end( 'A' + t.author )) a.skip_to( id );
+          if (a == writer.postlist_end( 'A' + t.author ) || *a != id) {
+            MDEBUG( "Tombstone of " << hex(t.hash) << " not by author" );
+            continue;
+          }
+          auto v = writer.get_document( id ).get_value( TIME_SLOT );
+          writer.delete_document( id );
+          db.update_author( t.author, -1,
+                            v.empty() ? 0.0 : Xapian::sortable_unserialise(v) );
+          removed.push_back( t.hash );
+        }
+        db.tombstone( t );
+        fresh.push_back( t );
+      }
+      writer.commit_transaction();
+    } catch ( const Xapian::Error& ) {
+      writer.cancel_transaction();
+      throw;
+    }
+
+  } catch ( const Xapian::Error &e ) {
+    MERROR( e.get_description() );
+    removed.clear();
+    return {};
+  }
+
+  return fresh;
 }
 
 [[nodiscard]] std::vector< std::string >
-piac::db_list_hash( const std::string& db_name, bool inhex )
+piac::db_list_hash( Database& db, bool inhex )
 // *****************************************************************************
 //  List hashes from Xapian database
-//! \param[in] db_name Name of the Xapian database object
+//! \param[in,out] db Xapian database to list hashes of
 //! \param[in] inhex True to list hashes hex-encoded
 //! \return List of hashes
+//! \details The hash of each document is stored as its unique 'Q'-prefixed
+//!   term, so the hashes are read from the term list without loading and
+//!   rehashing the document data.
 // *****************************************************************************
 {
   std::vector< std::string > hashes;
   try {
 
-    Xapian::Database db( db_name );
-    Xapian::doccount dbsize = db.get_doccount();
+    const auto& reader = db.reader();
+    Xapian::doccount dbsize = reader.get_doccount();
     if (dbsize == 0) return {};
 
-    for (auto it = db.postlist_begin({}); it != db.postlist_end({}); ++it) {
-      auto entry = db.get_document( *it ).get_data();
-      auto digest = sha256( entry );
-      hashes.emplace_back( inhex ? hex(digest) : digest );
+    hashes.reserve( dbsize );
+    for (auto it = reader.allterms_begin( "Q" );
+         it != reader.allterms_end( "Q" ); ++it)
+    {
+      auto digest = (*it).substr( 1 );
+      hashes.emplace_back( inhex ? hex(digest) : std::move(digest) );
     }
 
   } catch ( const Xapian::Error &e ) {
@@ -351,27 +1912,71 @@ piac::db_list_hash( const std::string& db_name, bool inhex )
 }
 
 [[nodiscard]] std::vector< std::string >
-piac::db_list_doc( const std::string& db_name )
+piac::db_list_hash( Database& db, std::string& cursor, std::size_t max )
 // *****************************************************************************
-//  List documents from Xapian database
-//! \param[in] db_name Name of the Xapian database object
-//! \return List of documents
+//  List a chunk of hashes from Xapian database
+//! \param[in,out] db Xapian database to list hashes of
+//! \param[in,out] cursor On input: hex hash to list after, empty: from the
+//!   first, on output: hex hash of last listed if there are more, else empty
+//! \param[in] max Maximum number of hashes to list
+//! \return List of hex-encoded hashes
 // *****************************************************************************
 {
-  std::vector< std::string > docs;
+  std::vector< std::string > hashes;
   try {
 
-    Xapian::Database db( db_name );
-    Xapian::doccount dbsize = db.get_doccount();
-    if (dbsize == 0) return {};
+    const auto& reader = db.reader();
+    auto it = reader.allterms_begin( "Q" );
+    if (not cursor.empty()) {
+      auto after = 'Q' + unhex( cursor );
+      it.skip_to( after );
+      if (it != reader.allterms_end( "Q" ) && *it == after) ++it;
+    }
+    cursor.clear();
+    for (; it != reader.allterms_end( "Q" ); ++it) {
+      if (hashes.size() == max) {
+        cursor = hashes.back();
+        break;
+      }
+      hashes.emplace_back( hex( (*it).substr( 1 ) ) );
+    }
+
+  } catch ( const Xapian::Error &e ) {
+    if (e.get_description().find("No such file") == std::string::npos)
+      MERROR( e.get_description() );
+  }
+
+  return hashes;
+}
+
+[[nodiscard]] std::vector< std::string >
+piac::db_list_doc( Database& db, std::string& cursor, std::size_t max )
+// *****************************************************************************
+//  List a chunk of documents from Xapian database
+//! \param[in,out] db Xapian database to list documents of
+//! \param[in,out] cursor On input: hex hash of document to list after, empty:
+//!   from the first, on output: hex hash of last listed if there are more,
+//!   else empty
+//! \param[in] max Maximum number of documents to list
+//! \return List of documents, ordered by hash
+//! \details Documents are walked in the order of their 'Q'-prefixed hash
+//!   terms, so listing can be continued from any hash and only the documents
+//!   of the chunk are read.
+// *****************************************************************************
+{
+  std::vector< std::string > docs;
+  auto hashes = db_list_hash( db, cursor, max );
+  try {
 
-    for (auto it = db.postlist_begin({}); it != db.postlist_end({}); ++it) {
-      auto entry = db.get_document( *it ).get_data();
-      auto digest = sha256( entry );
+    const auto& reader = db.reader();
+    for (const auto& h : hashes) {
+      auto q = 'Q' + unhex( h );
+      auto p = reader.postlist_begin( q );
+      if (p == reader.postlist_end( q )) continue;
       Document d;
-      d.deserialize( entry );
+      d.deserialize( reader.get_document( *p ).get_data() );
       d.author( hex( d.author() ) );
-      docs.emplace_back( hex( digest ) + ": " + d.serialize() );
+      docs.emplace_back( h + ": " + d.serialize() );
     }
 
   } catch ( const Xapian::Error &e ) {
@@ -383,47 +1988,157 @@ piac::db_list_doc( const std::string& db_name )
 }
 
 [[nodiscard]] std::size_t
-piac::db_list_numuser( const std::string& db_name )
+piac::db_list_numuser( Database& db )
 // *****************************************************************************
 //  List number of unique users in Xapian database
-//! \param[in] db_name Name of the Xapian database object
+//! \param[in,out] db Xapian database to count users in
 //! \return Number of unique users created documents in database
+//! \details Counts the author terms, without looking at any documents.
 // *****************************************************************************
 {
   try {
 
-    Xapian::Database db( db_name );
-    Xapian::doccount dbsize = db.get_doccount();
-    if (dbsize == 0) return {};
+    const auto& reader = db.reader();
+    std::size_t n = 0;
+    for (auto it = reader.allterms_begin( "A" );
+         it != reader.allterms_end( "A" ); ++it)
+    {
+      ++n;
+    }
+    return n;
+
+  } catch ( const Xapian::Error &e ) {
+    if (e.get_description().find("No such file") == std::string::npos)
+      MERROR( e.get_description() );
+  }
+
+  return {};
+}
+
+[[nodiscard]] std::vector< std::string >
+piac::db_list_author( Database& db,
+                      const std::string& author,
+                      std::string& cursor,
+                      std::size_t max )
+// *****************************************************************************
+//  List a chunk of documents of an author from Xapian database
+//! \param[in,out] db Xapian database to list documents of
+//! \param[in] author Author whose documents to list
+//! \param[in,out] cursor On input: numbering and document id to list after,
+//!   empty: from the first, on output: numbering and document id of last
+//!   listed if there are more, else empty
+//! \param[in] max Maximum number of documents to list
+//! \return List of documents of the author
+//! \details Walks the posting list of the author term only and takes the
+//!   hashes from the Q terms instead of rehashing the documents. The cursor is
+//!   rejected if a merge renumbered the documents since it was handed out.
+// *****************************************************************************
+{
+  std::vector< std::string > docs;
+  try {
 
-    std::unordered_set< std::string > user;
-    for (auto it = db.postlist_begin({}); it != db.postlist_end({}); ++it) {
-      auto entry = db.get_document( *it ).get_data();
+    const auto& reader = db.reader();
+    auto numbering = std::to_string( db.numbering() );
+    auto term = 'A' + author;
+    auto it = reader.postlist_begin( term );
+    if (not cursor.empty()) {
+      auto sep = cursor.find( ':' );
+      auto taken = cursor.substr( 0, sep );
+      Xapian::docid after = 0;
+      bool valid = sep != std::string::npos &&
+                   to_number( cursor.substr( sep + 1 ), after );
+      cursor.clear();
+      if (not valid) return { "db list mine: invalid cursor" };
+      if (taken != numbering) {
+        return { "db list mine: stale cursor, documents renumbered by a "
+                 "merge, list again" };
+      }
+      it.skip_to( after + 1 );
+    }
+    cursor.clear();
+    Xapian::docid last = 0;
+    for (; it != reader.postlist_end( term ); ++it) {
+      if (docs.size() == max) {
+        cursor = numbering + ':' + std::to_string( last );
+        break;
+      }
+      last = *it;
+      auto doc = reader.get_document( *it );
+      auto q = doc.termlist_begin();
+      q.skip_to( "Q" );
+      if (q == doc.termlist_end() || (*q)[0] != 'Q') continue;
       Document d;
-      d.deserialize( entry );
-      user.insert( d.author() );
+      d.deserialize( doc.get_data() );
+      d.author( hex( d.author() ) );
+      auto t = doc.get_value( TIME_SLOT );
+      docs.emplace_back( hex( (*q).substr( 1 ) ) + ": " +
+        timestamp( t.empty() ? 0.0 : Xapian::sortable_unserialise( t ) ) +
+        ": " + d.serialize() );
     }
-    return user.size();
 
+  } catch ( const Xapian::Error &e ) {
+    if (e.get_description().find("No such file") == std::string::npos)
+      MERROR( e.get_description() );
+  }
+
+  return docs;
+}
+
+[[nodiscard]] std::vector< std::string >
+piac::db_list_authors( Database& db, std::string& cursor, std::size_t max )
+// *****************************************************************************
+//  List a chunk of aggregates of authors in Xapian database
+//! \param[in,out] db Xapian database to list authors of
+//! \param[in,out] cursor On input: hex author to list after, empty: from the
+//!   first, on output: hex author of last listed if there are more, else empty
+//! \param[in] max Maximum number of authors to list
+//! \return List of authors with their number of documents and time of newest
+//! \details Reads the aggregates maintained in the database metadata.
+// *****************************************************************************
+{
+  std::vector< std::string > authors;
+  try {
+
+    const auto& reader = db.reader();
+    auto it = reader.allterms_begin( "A" );
+    if (not cursor.empty()) {
+      auto after = 'A' + unhex( cursor );
+      it.skip_to( after );
+      if (it != reader.allterms_end( "A" ) && *it == after) ++it;
+    }
+    cursor.clear();
+    std::string last;
+    for (; it != reader.allterms_end( "A" ); ++it) {
+      if (authors.size() == max) {
+        cursor = hex( last );
+        break;
+      }
+      last = (*it).substr( 1 );
+      auto a = db.author_stats( last );
+      authors.emplace_back( hex( last ) + ": ads: " +
+        std::to_string( a.ads ) + ", newest: " + timestamp( a.newest ) );
+    }
 
   } catch ( const Xapian::Error &e ) {
     if (e.get_description().find("No such file") == std::string::npos)
       MERROR( e.get_description() );
   }
 
-  return {};
+  return authors;
 }
 
 std::string
 piac::db_add( const std::string& author,
-              const std::string& db_name,
+              Database& db,
               std::string&& cmd,
-              const std::unordered_set< std::string >& my_hashes )
+              std::vector< std::string >& added,
+              const HashSet& my_hashes )
 // *****************************************************************************
 //  Add documents to Xapian database
 //! \param[in] author Author of the database document
-//! \param[in] db_name Name of the Xapian database object
+//! \param[in,out] db Xapian database to add documents to
 //! \param[in,out] cmd Add command
+//! \param[in,out] added Hashes of documents added appended to
 //! \param[in] my_hashes Hashes to check for duplicates when adding documents
 //! \return Info string after add database operation
 // *****************************************************************************
@@ -434,21 +2149,28 @@ piac::db_add( const std::string& author,
   if (cmd[0]=='j' && cmd[1]=='s' && cmd[2]=='o' && cmd[3]=='n') {
     cmd.erase( 0, 5 );
     MDEBUG( "Add json file: '" << cmd << "' to db" );
-    return index_db( author, db_name, cmd, my_hashes );
+    return index_db( author, db, cmd, added, my_hashes );
   }
   return "unknown cmd";
 }
 
 std::string
 piac::db_rm( const std::string& author,
-             const std::string& db_name,
+             Database& db,
              std::string&& cmd,
-             const std::unordered_set< std::string >& my_hashes )
+             const std::string& sign,
+             std::vector< std::string >& removed,
+             const HashSet& my_hashes )
 // *****************************************************************************
 //  Remove documents from Xapian database
 //! \param[in] author Author of the database document
-//! \param[in] db_name Name of the Xapian database object
-//! \param[in,out] cmd Remove command
+//! \param[in,out] db Xapian database to remove documents from
+//! \param[in,out] cmd Remove command: hex hashes of documents to remove, or
+//!   "file <path>" to remove the documents whose hex hashes are listed in a
+//!   file, separated by white space
+//! \param[in] sign Tombstones signed by the author: their address and time
+//!   of deletion followed by "<hex-hash>:<signature>" of each document
+//! \param[in,out] removed Hashes of documents removed appended to
 //! \param[in] my_hashes Hashes to check for duplicates when removing documents
 //! \return Info string after remove database operation
 // *****************************************************************************
@@ -456,56 +2178,149 @@ piac::db_rm( const std::string& author,
   trim( cmd );
   MDEBUG( "db rm " + cmd );
   assert( not author.empty() );
-  if (not cmd.empty()) {
+  std::unordered_map< std::string, Tombstone > tombs;
+  std::stringstream ss( sign );
+  Tombstone t;
+  t.author = author;
+  if (ss >> t.address >> t.time) {
+    for (std::string s; ss >> s; ) {
+      auto c = s.find( ':' );
+      if (c == std::string::npos) continue;
+      t.hash = unhex( s.substr( 0, c ) );
+      t.signature = s.substr( c + 1 );
+      tombs[ t.hash ] = t;
+    }
+  }
+  if (cmd.rfind( "file ", 0 ) == 0) {
+    cmd.erase( 0, 5 );
+    trim( cmd );
+    std::ifstream f( cmd );
+    if (not f.good()) return "Cannot open file: " + cmd;
+    std::unordered_set< std::string > hashes_to_delete;
+    for (std::string h; f >> h; ) hashes_to_delete.insert( std::move(h) );
+    return db_rm_docs( author, db, hashes_to_delete, tombs, removed,
+                       my_hashes );
+  } else if (not cmd.empty()) {
     auto h = tokenize( cmd );
     std::unordered_set< std::string > hashes_to_delete( begin(h), end(h) );
-    return db_rm_docs( author, db_name, hashes_to_delete, my_hashes );
+    return db_rm_docs( author, db, hashes_to_delete, tombs, removed,
+                       my_hashes );
   }
   return "unknown cmd";
 }
 
+namespace piac {
+
+static std::string
+chunk( std::string&& header,
+       std::vector< std::string >&& items,
+       const std::string& cursor )
+// *****************************************************************************
+//! Assemble a chunk of a list reply
+//! \param[in] header Header, only sent with the first chunk, empty if none
+//! \param[in] items Items of the chunk, one per line
+//! \param[in] cursor Continuation token if there are more items, else empty
+//! \return Chunk of list reply, whose last line is "Continue: <token>" if
+//!   there are more items to list. To get the next chunk, the same list
+//!   command is to be sent with "--after <token>" appended.
+// *****************************************************************************
+{
+  auto result = std::move( header );
+  for (auto&& i : items) result += std::move(i) + '\n';
+  if (not cursor.empty()) result += "Continue: " + cursor + '\n';
+  if (not result.empty()) result.pop_back();
+  return result;
+}
+
+} // piac::
+
 std::string
-piac::db_list( const std::string& db_name, std::string&& cmd )
+piac::db_list( Database& db, std::string&& cmd, const std::string& author )
 // *****************************************************************************
 //  List Xapian database
-//! \param[in] db_name Name of the Xapian database object
-//! \param[in,out] cmd List command
+//! \param[in,out] db Xapian database to list
+//! \param[in,out] cmd List command, optionally followed by "--chunk <num>" to
+//!   list at most num items and "--after <token>" to continue listing
+//! \param[in] author Author of user listing, if known
 //! \return List of items queried from database
+//! \details Lists that can be large are returned in chunks of a configurable
+//!   size so that neither the daemon nor the client has to hold the whole list
+//!   in memory and the db thread is not blocked for long. See chunk().
 // *****************************************************************************
 {
-  trim( cmd );
-  MDEBUG( "db list " + cmd );
+  // extract chunk options
+  std::stringstream ss( cmd );
+  std::string cursor;
+  auto max = db.list_chunk();
+  cmd.clear();
+  for (std::string w; ss >> w; ) {
+    if (w == "--after") {
+      ss >> cursor;
+    } else if (w == "--chunk") {
+      ss >> max;
+      max = std::clamp< std::size_t >( max, 1, MAX_LIST_CHUNK );
+    } else {
+      cmd += (cmd.empty() ? "" : " ") + w;
+    }
+  }
+  auto first = cursor.empty();
+  MDEBUG( "db list " + cmd + (first ? "" : " after " + cursor) );
 
   if (cmd.empty()) {
 
-    auto docs = db_list_doc( db_name );
-    std::string result( "Number of documents: " +
-                        std::to_string( docs.size() ) + '\n' );
-    for (auto&& d : docs) result += std::move(d) + '\n';
-    result.pop_back();
-    return result;
+    auto docs = db_list_doc( db, cursor, max );
+    return chunk( first ? "Number of documents: " +
+                          std::to_string( get_doccount( db ) ) + '\n' : "",
+                  std::move(docs), cursor );
 
   } else if (cmd[0]=='n' && cmd[1]=='u' && cmd[2]=='m' && cmd[3]=='d' &&
              cmd[4]=='o' && cmd[5]=='c')
   {
 
-    return "Number of documents: " + std::to_string( get_doccount( db_name ) );
+    return "Number of documents: " + std::to_string( get_doccount( db ) );
 
   } else if (cmd[0]=='n' && cmd[1]=='u' && cmd[2]=='m' && cmd[3]=='u' &&
              cmd[4]=='s' && cmd[5]=='r')
   {
 
-    return "Number of users: " + std::to_string( db_list_numuser( db_name ) );
+    return "Number of users: " + std::to_string( db_list_numuser( db ) );
+
+  } else if (cmd[0]=='m' && cmd[1]=='i' && cmd[2]=='n' && cmd[3]=='e') {
+
+    if (author.empty()) return "db list mine: unknown user";
+    auto a = db.author_stats( author );
+    auto docs = db_list_author( db, author, cursor, max );
+    return chunk( first ? "Number of documents: " + std::to_string( a.ads ) +
+                          ", newest: " + timestamp( a.newest ) + '\n' : "",
+                  std::move(docs), cursor );
+
+  } else if (cmd[0]=='a' && cmd[1]=='u' && cmd[2]=='t' && cmd[3]=='h' &&
+             cmd[4]=='o' && cmd[5]=='r' && cmd[6]=='s')
+  {
+
+    auto authors = db_list_authors( db, cursor, max );
+    return chunk( first ? "Number of users: " +
+                          std::to_string( db_list_numuser( db ) ) + '\n' : "",
+                  std::move(authors), cursor );
+
+  } else if (cmd[0]=='c' && cmd[1]=='a' && cmd[2]=='c' && cmd[3]=='h' &&
+             cmd[4]=='e')
+  {
+
+    return db.cache().stats();
+
+  } else if (cmd[0]=='s' && cmd[1]=='t' && cmd[2]=='a' && cmd[3]=='t' &&
+             cmd[4]=='s')
+  {
+
+    return db.stats();
 
   } else if (cmd[0]=='h' && cmd[1]=='a' && cmd[2]=='s' && cmd[3]=='h') {
 
-    cmd.erase( 0, 5 );
-    auto hashes = db_list_hash( db_name, /* inhex = */ true );
-    std::string result( "Number of documents: " +
-                        std::to_string( hashes.size() ) + '\n' );
-    for (auto&& h : hashes) result += std::move(h) + '\n';
-    result.pop_back();
-    return result;
+    auto hashes = db_list_hash( db, cursor, max );
+    return chunk( first ? "Number of documents: " +
+                          std::to_string( get_doccount( db ) ) + '\n' : "",
+                  std::move(hashes), cursor );
 
   }
 
@@ -10,7 +10,14 @@
 #pragma once
 
 #include <vector>
+#include <list>
+#include <algorithm>
+#include <unordered_map>
 #include <unordered_set>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 
 #if defined(__clang__)
   #pragma clang diagnostic push
@@ -24,74 +31,471 @@
 #endif
 
 #include "document.hpp"
+#include "index_schema.hpp"
+#include "hash256.hpp"
+#include "tombstone.hpp"
 
 namespace piac {
 
+//! Default number of documents to index between commits when adding in bulk
+const std::size_t DEFAULT_BATCH_DOCS = 10000;
+//! Default number of bytes of input to index between commits in bulk
+const std::size_t DEFAULT_BATCH_BYTES = 64 * 1024 * 1024;
+
+//! Default number of threads serving queries, lists and lookups concurrently
+const std::size_t DEFAULT_QUERY_THREADS = 2;
+
+//! Default number of seconds between scheduled compactions, 0: never
+const double DEFAULT_COMPACT_INTERVAL = 24 * 60 * 60;
+//! Default ratio of documents added and removed to documents in the database
+//! that triggers compaction, 0: never
+const double DEFAULT_COMPACT_CHURN = 0.5;
+//! Minimum number of documents added and removed to trigger compaction
+const std::size_t MIN_COMPACT_CHURN = 1000;
+
+//! Value slot storing the price of documents, sortable-serialised
+const Xapian::valueno PRICE_SLOT = 1;
+//! Value slots storing document fields to count facets of
+const Xapian::valueno CATEGORY_SLOT = 2;
+const Xapian::valueno CONDITION_SLOT = 3;
+const Xapian::valueno LOCATION_SLOT = 4;
+const Xapian::valueno FORMAT_SLOT = 5;
+//! Value slot storing the time a document was added, sortable-serialised
+const Xapian::valueno TIME_SLOT = 6;
+
+//! Version of the layout of terms and values indexed, bump when changed
+//! \details Version 0: price stored as a plain string, 1: price sortable,
+//!   2: facet values, 3: author terms, time added and author aggregates.
+const unsigned DB_SCHEMA_VERSION = 3;
+
+//! Aggregates of documents of an author, stored in the database metadata
+struct AuthorStats {
+  //! Number of documents of the author
+  Xapian::doccount ads = 0;
+  //! Time the newest document of the author was added, seconds since epoch,
+  //! 0 if unknown
+  double newest = 0.0;
+};
+
+//! Default number of most frequent values returned per facet
+const std::size_t DEFAULT_FACET_TOP = 10;
+//! Default minimum number of matches to examine to count facets
+//! \details Broad queries match many more documents than this and facet
+//!   counts are then computed from a sample of (at least) this many matches.
+const Xapian::doccount DEFAULT_FACET_CHECK = 1000;
+
+//! Default number of query results returned
+const Xapian::doccount DEFAULT_QUERY_LIMIT = 10;
+//! Maximum number of query results returned at a time
+const Xapian::doccount MAX_QUERY_LIMIT = 1000;
+
+//! Options controlling which query results to return and how
+//! \details Parsed from options preceding the query terms, e.g.,
+//!   "--offset 50 --limit 50 --fields title,price,hash --json laptop" or
+//!   "--sort -price laptop price:0.5..2" or
+//!   "--facets category,condition --facet-top 5 laptop".
+struct QueryOptions {
+  //! Rank of first result to return (0-based)
+  Xapian::doccount offset = 0;
+  //! Maximum number of results to return
+  Xapian::doccount limit = DEFAULT_QUERY_LIMIT;
+  //! Document fields to return, empty: the full document
+  std::vector< std::string > fields;
+  //! True to return results as JSON instead of text
+  bool json = false;
+  //! Order of results: empty: relevance, "price": ascending price,
+  //! "-price": descending price
+  std::string sort;
+  //! Document fields to count values of among matches
+  std::vector< std::string > facets;
+  //! Number of most frequent values to return per facet
+  std::size_t facet_top = DEFAULT_FACET_TOP;
+  //! Minimum number of matches to examine to count facets
+  Xapian::doccount facet_check = DEFAULT_FACET_CHECK;
+};
+
+//! Parse query options from the front of a query command
+[[nodiscard]] std::string
+parse_query_options( std::string& cmd, QueryOptions& opt );
+
+//! Default number of items returned per chunk by list commands
+const std::size_t DEFAULT_LIST_CHUNK = 1000;
+//! Maximum number of items returned per chunk by list commands
+const std::size_t MAX_LIST_CHUNK = 100000;
+
+//! Default maximum number of query results cached
+const std::size_t DEFAULT_QUERY_CACHE_ENTRIES = 1000;
+//! Default maximum number of bytes of query results cached
+const std::size_t DEFAULT_QUERY_CACHE_BYTES = 64 * 1024 * 1024;
+
+//! Least-recently-used cache of query results
+//! \details Keys identify a query and its options only; the database revision
+//!   a result was computed at is passed separately, along with the generation
+//!   of the database, as revisions start over in a database replaced, e.g.,
+//!   compacted. Whenever a different generation or revision is looked up or
+//!   stored, all entries are dropped, so a commit or a replace invalidates the
+//!   cache.
+class QueryCache {
+  public:
+    //! Constructor
+    QueryCache( std::size_t max_entries = DEFAULT_QUERY_CACHE_ENTRIES,
+                std::size_t max_bytes = DEFAULT_QUERY_CACHE_BYTES );
+
+    //! Configure limits, zero entries disables the cache
+    void limits( std::size_t max_entries, std::size_t max_bytes );
+
+    //! Look up a query result, return false if not cached
+    bool find( unsigned generation,
+               Xapian::rev revision,
+               const std::string& key,
+               std::string& result );
+
+    //! Store a query result
+    void insert( unsigned generation,
+                 Xapian::rev revision,
+                 const std::string& key,
+                 const std::string& result );
+
+    //! Return statistics on cache use
+    std::string stats() const;
+
+  private:
+    using Entry = std::pair< std::string, std::string >;
+
+    //! Drop all entries if generation or revision differs from the cached
+    void revise( unsigned generation, Xapian::rev revision );
+    //! Drop least-recently-used entries until within limits
+    void evict();
+
+    //! Maximum number of entries
+    std::size_t m_max_entries;
+    //! Maximum number of bytes in keys and results
+    std::size_t m_max_bytes;
+    //! Database generation of entries cached
+    unsigned m_generation;
+    //! Database revision of entries cached
+    Xapian::rev m_revision;
+    //! Entries, most-recently-used first
+    std::list< Entry > m_lru;
+    //! Entries indexed by key
+    std::unordered_map< std::string, std::list< Entry >::iterator > m_map;
+    //! Number of bytes in keys and results cached
+    std::size_t m_bytes;
+    //! Number of lookups found
+    std::size_t m_hits;
+    //! Number of lookups not found
+    std::size_t m_misses;
+    //! Number of entries evicted due to limits
+    std::size_t m_evictions;
+    //! Number of times entries were dropped due to a new revision
+    std::size_t m_invalidations;
+    //! Mutex serializing access by query workers sharing the cache
+    mutable std::mutex m_mutex;
+};
+
+//! Long-lived Xapian database handles owned by a single (db) thread
+//! \details Opening a Xapian database reads the table headers from disk and
+//!   constructing a query parser and a stemmer is not free either, so instead
+//!   of doing these on every call, a single writable database, a reader handle,
+//!   and the indexer and query parser are kept alive for the lifetime of the
+//!   object. The reader is refreshed via Xapian::Database::reopen() only if the
+//!   database revision has changed since it was last (re)opened. Query worker
+//!   threads each use their own read-only Database constructed from the one
+//!   owned by the db thread, sharing its query cache.
+class Database {
+  public:
+    //! Constructor: open database, create if it does not yet exist
+    explicit Database( const std::string& name,
+                       const IndexSchema& schema = IndexSchema() );
+
+    //! Tag selecting the constructor opening a read-only view
+    struct View {};
+
+    //! Constructor: open read-only view of a database owned by another thread
+    Database( Database& primary, View );
+
+    //! Name of the Xapian database
+    const std::string& name() const { return m_name; }
+
+    //! Writable database handle
+    Xapian::WritableDatabase& writer() { return m_writer; }
+
+    //! Reader handle, reopened if the database has changed since last opened
+    const Xapian::Database& reader();
+
+    //! Indexer to use for adding documents
+    Xapian::TermGenerator& indexer() { return m_indexer; }
+
+    //! Query parser to use for queries, attached to the reader handle
+    Xapian::QueryParser& parser() { reader(); return m_parser; }
+
+    //! Commit pending changes to database
+    void commit();
+
+    //! Merge databases into this database
+    void merge( const std::vector< std::string >& dbs );
+
+    //! Replace this database with another one, e.g., a merged or compacted one
+    void replace( const std::string& dir );
+
+    //! Version of the layout of terms and values of the database
+    unsigned schema_version();
+
+    //! Reindex all documents to the current schema version and index schema
+    void upgrade();
+
+    //! Index schema configuring how document fields are indexed
+    const IndexSchema& schema() const { return m_schema; }
+
+    //! Record documents indexed and time spent indexing them
+    void indexed( std::size_t docs, double seconds ) {
+      m_indexed_docs += docs;
+      m_index_seconds += seconds;
+    }
+
+    //! Report index size, indexing throughput and index schema
+    std::string stats();
+
+    //! Start compacting the database in the background
+    bool compact();
+
+    //! Run scheduled maintenance, call periodically from the db thread
+    std::string maintain();
+
+    //! Number of seconds between scheduled compactions, 0: never
+    double compact_interval() const { return m_compact_interval; }
+    void compact_interval( double s ) { m_compact_interval = std::max( s, 0.0 ); }
+
+    //! Ratio of documents changed to all documents that triggers compaction
+    double compact_churn() const { return m_compact_churn; }
+    void compact_churn( double r ) { m_compact_churn = std::max( r, 0.0 ); }
+
+    //! Aggregates of documents of an author
+    AuthorStats author_stats( const std::string& author );
+
+    //! Update aggregates of an author after documents added or removed
+    void update_author( const std::string& author,
+                        long long ads,
+                        double time );
+
+    //! Number of seconds tombstones are kept for
+    double tombstone_horizon() const { return m_tombstone_horizon; }
+    void tombstone_horizon( double s ) {
+      m_tombstone_horizon = std::max( s, 0.0 );
+    }
+
+    //! Record tombstone of a document deleted by its author
+    void tombstone( const Tombstone& t );
+
+    //! Look up tombstone of a document
+    bool tombstone( const std::string& hash, Tombstone& t );
+
+    //! All tombstones kept
+    std::vector< Tombstone > tombstones();
+
+    //! Remove tombstones past their horizon
+    std::vector< std::string > expire_tombstones( std::int64_t now );
+
+    //! Number of threads to use for bulk indexing
+    std::size_t index_threads() const { return m_index_threads; }
+    void index_threads( std::size_t n ) { m_index_threads = n ? n : 1; }
+
+    //! Number of documents to index between commits when adding in bulk
+    std::size_t batch_docs() const { return m_batch_docs; }
+    void batch_docs( std::size_t n ) { m_batch_docs = n ? n : 1; }
+
+    //! Number of bytes of input to index between commits when adding in bulk
+    std::size_t batch_bytes() const { return m_batch_bytes; }
+    void batch_bytes( std::size_t n ) { m_batch_bytes = n ? n : 1; }
+
+    //! Number of items to return per chunk by list commands
+    std::size_t list_chunk() const { return m_list_chunk; }
+    void list_chunk( std::size_t n ) {
+      m_list_chunk = std::clamp< std::size_t >( n, 1, MAX_LIST_CHUNK );
+    }
+
+    //! Cache of query results, shared with read-only views
+    QueryCache& cache() { return m_primary ? m_primary->m_cache : m_cache; }
+
+    //! Number of times document ids have been renumbered by merging
+    unsigned long numbering();
+
+    //! Number of times the database has been replaced when last opened
+    unsigned generation() const { return m_generation; }
+
+  private:
+    //! (Re)open database handles
+    void open();
+
+    //! Name of the Xapian database
+    std::string m_name;
+    //! Writable database handle, the only one allowed
+    Xapian::WritableDatabase m_writer;
+    //! Reader handle used for queries and lookups
+    Xapian::Database m_reader;
+    //! Stemmer used by both the indexer and the query parser
+    Xapian::Stem m_stemmer;
+    //! Indexer used to add documents
+    Xapian::TermGenerator m_indexer;
+    //! Query parser used to parse queries
+    Xapian::QueryParser m_parser;
+    //! Number of threads to use for bulk indexing
+    std::size_t m_index_threads;
+    //! Number of documents to index between commits
+    std::size_t m_batch_docs;
+    //! Number of bytes of input to index between commits
+    std::size_t m_batch_bytes;
+    //! Number of items to return per chunk by list commands
+    std::size_t m_list_chunk;
+    //! Cache of query results
+    QueryCache m_cache;
+    //! Index schema configuring how document fields are indexed
+    IndexSchema m_schema;
+    //! Number of documents indexed since opened
+    std::size_t m_indexed_docs;
+    //! Seconds spent indexing since opened
+    double m_index_seconds;
+    //! Number of seconds between scheduled compactions
+    double m_compact_interval;
+    //! Ratio of documents changed to all documents that triggers compaction
+    double m_compact_churn;
+    //! Number of seconds tombstones are kept for
+    double m_tombstone_horizon;
+    //! Number of documents added and removed since last compaction started
+    std::size_t m_churn;
+    //! Time last compaction finished or the database was opened
+    std::chrono::steady_clock::time_point m_compacted;
+    //! Time compaction in progress started
+    std::chrono::steady_clock::time_point m_compact_start;
+    //! Size on disk before compaction in progress
+    std::uintmax_t m_compact_before;
+    //! Number of rounds of compaction in progress so far
+    std::size_t m_compact_rounds;
+    //! Compaction in progress, yields the revision compacted copy is at
+    std::future< Xapian::rev > m_compaction;
+    //! Report of last compaction
+    std::string m_compact_report;
+    //! Database owned by another thread if this is a read-only view
+    Database* m_primary;
+    //! Number of times the database has been replaced, e.g., compacted
+    std::atomic< unsigned > m_generation;
+};
+
+//! Configure indexer to index documents the same way everywhere
+void setup_indexer( Xapian::TermGenerator& indexer, const Xapian::Stem& stemmer );
+
 //! Get number of documents in Xapian database
-Xapian::doccount get_doccount( const std::string db_name );
+Xapian::doccount get_doccount( Database& db );
+
+//! Add value slots of a document
+void add_values( Xapian::Document& doc, const Document& ndoc );
 
 //! Add document to Xapian database
 std::string
 add_document( const std::string& author,
+              const IndexSchema& schema,
               Xapian::TermGenerator& indexer,
               Xapian::WritableDatabase& db,
               Document& ndoc );
 
+//! Add document already serialized and hashed to Xapian database
+std::string
+add_document( const IndexSchema& schema,
+              Xapian::TermGenerator& indexer,
+              Xapian::WritableDatabase& db,
+              const Document& ndoc,
+              const std::string& entry,
+              const std::string& sha );
+
 //! Index Xapian database
 std::string
 index_db( const std::string& author,
-          const std::string& db_name,
+          Database& db,
           const std::string& input_filename,
-          const std::unordered_set< std::string >& my_hashes = {} );
+          std::vector< std::string >& added,
+          const HashSet& my_hashes = {} );
 
 //! Query Xapian database
 [[nodiscard]] std::string
-db_query( const std::string& db_name, std::string&& cmd );
+db_query( Database& db, std::string&& cmd );
 
 //! Get documents from Xapian database
 [[nodiscard]] std::vector< std::string >
-db_get_docs( const std::string& db_name,
-             const std::vector< std::string >& hashes );
+db_get_docs( Database& db,
+             const std::vector< std::string >& hashes,
+             std::size_t max_bytes,
+             std::size_t& served );
 
-//! Put documents to Xapian database
-std::size_t
-db_put_docs( const std::string& db_name,
-             const std::vector< std::string >& docs );
+//! Put documents to Xapian database in a single transaction
+bool
+db_put_docs( Database& db,
+             const std::vector< std::string >& docs,
+             const std::vector< std::string >& hashes,
+             std::vector< std::string >& added,
+             bool commit = true );
 
-//! Remove documents from Xapian database
+//! Remove documents from Xapian database in a single transaction
 std::string
 db_rm_docs( const std::string& author,
-            const std::string& db_name,
+            Database& db,
             const std::unordered_set< std::string >& hashes_to_delete,
-            const std::unordered_set< std::string >& my_hashes = {} );
+            const std::unordered_map< std::string, Tombstone >& tombs,
+            std::vector< std::string >& removed,
+            const HashSet& my_hashes = {} );
+
+//! Remove documents deleted by their authors at peers
+std::vector< Tombstone >
+db_bury_docs( Database& db,
+              const std::vector< Tombstone >& tombs,
+              std::vector< std::string >& removed );
 
 //! List hashes from Xapian database
 [[nodiscard]] std::vector< std::string >
-db_list_hash( const std::string& db_name, bool inhex );
+db_list_hash( Database& db, bool inhex );
+
+//! List a chunk of hashes from Xapian database
+[[nodiscard]] std::vector< std::string >
+db_list_hash( Database& db, std::string& cursor, std::size_t max );
 
-//! List documents from Xapian database
+//! List a chunk of documents from Xapian database
 [[nodiscard]] std::vector< std::string >
-db_list_doc( const std::string& db_name );
+db_list_doc( Database& db, std::string& cursor, std::size_t max );
 
 //! List number of unique users in Xapian database
 [[nodiscard]] std::size_t
-db_list_numuser( const std::string& db_name );
+db_list_numuser( Database& db );
+
+//! List a chunk of documents of an author from Xapian database
+[[nodiscard]] std::vector< std::string >
+db_list_author( Database& db,
+                const std::string& author,
+                std::string& cursor,
+                std::size_t max );
+
+//! List a chunk of aggregates of authors in Xapian database
+[[nodiscard]] std::vector< std::string >
+db_list_authors( Database& db, std::string& cursor, std::size_t max );
 
 //! Add documents to Xapian database
 std::string
 db_add( const std::string& author,
-        const std::string& db_name,
+        Database& db,
         std::string&& cmd,
-        const std::unordered_set< std::string >& my_hashes = {} );
+        std::vector< std::string >& added,
+        const HashSet& my_hashes = {} );
 
 //! Remove documents from Xapian database
 std::string
 db_rm( const std::string& author,
-       const std::string& db_name,
+       Database& db,
        std::string&& cmd,
-       const std::unordered_set< std::string >& my_hashes );
+       const std::string& sign,
+       std::vector< std::string >& removed,
+       const HashSet& my_hashes );
 
 //! List Xapian database
-std::string db_list( const std::string& db_name, std::string&& cmd );
+std::string db_list( Database& db,
+                     std::string&& cmd,
+                     const std::string& author = {} );
 
 } // piac::
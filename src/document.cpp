@@ -8,12 +8,105 @@
 // *****************************************************************************
 
 #include <vector>
+#include <cstdio>
+#include <memory>
+
+#include "rapidjson/filereadstream.h"
 
 #include "document.hpp"
 
 using piac::Document;
 using piac::Documents;
 
+namespace piac {
+
+//! SAX handler to build documents one by one as they are parsed
+class DocumentHandler :
+  public rapidjson::BaseReaderHandler< rapidjson::UTF8<>, DocumentHandler >
+{
+  public:
+    using Callback = std::function< void( Document&&, std::size_t ) >;
+
+    DocumentHandler( const rapidjson::FileReadStream& stream,
+                     const Callback& callback ) :
+      m_stream( stream ), m_callback( callback ), m_depth( 0 ),
+      m_nested( 0 ), m_key(), m_doc() {}
+
+    bool StartObject() {
+      if (m_depth++ == 0) {
+        m_doc = Document();
+        m_doc.id( 0 );
+        m_doc.price( 0.0 );
+      }
+      return true;
+    }
+
+    bool EndObject( rapidjson::SizeType ) {
+      if (--m_depth == 0) m_callback( std::move(m_doc), m_stream.Tell() );
+      return true;
+    }
+
+    bool StartArray() { if (m_depth > 0) ++m_nested; return true; }
+
+    bool EndArray( rapidjson::SizeType ) {
+      if (m_depth > 0) --m_nested;
+      return true;
+    }
+
+    bool Key( const char* str, rapidjson::SizeType length, bool ) {
+      if (field()) m_key.assign( str, length );
+      return true;
+    }
+
+    bool String( const char* str, rapidjson::SizeType length, bool ) {
+      if (not field()) return true;
+      std::string v( str, length );
+      if (m_key == "title") m_doc.title( v );
+      else if (m_key == "author") m_doc.author( v );
+      else if (m_key == "description") m_doc.description( v );
+      else if (m_key == "category") m_doc.category( v );
+      else if (m_key == "condition") m_doc.condition( v );
+      else if (m_key == "shipping") m_doc.shipping( v );
+      else if (m_key == "format") m_doc.format( v );
+      else if (m_key == "location") m_doc.location( v );
+      else if (m_key == "keywords") m_doc.keywords( v );
+      return true;
+    }
+
+    bool Int( int i ) { return Number( i ); }
+    bool Uint( unsigned u ) { return Number( u ); }
+    bool Int64( int64_t i ) { return Number( static_cast< double >( i ) ); }
+    bool Uint64( uint64_t u ) { return Number( static_cast< double >( u ) ); }
+    bool Double( double d ) { return Number( d ); }
+
+  private:
+    //! Stream parsed, queried for the number of bytes consumed
+    const rapidjson::FileReadStream& m_stream;
+    //! Function to call on each document parsed
+    const Callback& m_callback;
+    //! Object nesting depth, 1: inside a document
+    int m_depth;
+    //! Array nesting depth inside a document
+    int m_nested;
+    //! Key of the document field being parsed
+    std::string m_key;
+    //! Document being parsed
+    Document m_doc;
+
+    //! Return true if parsing a field of a document
+    bool field() const { return m_depth == 1 && m_nested == 0; }
+
+    //! Store a numeric document field
+    bool Number( double d ) {
+      if (not field()) return true;
+      if (m_key == "id") m_doc.id( static_cast< int >( d ) );
+      else if (m_key == "price") m_doc.price( d );
+      return true;
+    }
+};
+
+} // piac::
+
 bool
 Document::deserialize( const rapidjson::Value& obj )
 // ****************************************************************************
@@ -85,6 +178,30 @@ Documents::deserialize( const std::string& s )
   return true;
 }
 
+bool
+Documents::stream(
+  const std::string& filePath,
+  const std::function< void( Document&&, std::size_t ) >& callback )
+// ****************************************************************************
+//  Stream (piac) documents from JSON in file, calling a function on each
+//! \param[in] filePath Filename containing a JSON object or array of objects
+//! \param[in] callback Function to call with each document as soon as it is
+//!   parsed and the number of bytes of the file consumed so far
+//! \return True if no error occurred
+//! \details The file is read through a fixed-size buffer and parsed using the
+//!   SAX API, so memory use is independent of the size of the file.
+// ****************************************************************************
+{
+  std::unique_ptr< std::FILE, decltype(&std::fclose) >
+    f( std::fopen( filePath.c_str(), "rb" ), &std::fclose );
+  if (not f) return false;
+  std::vector< char > buffer( 1 << 16 );
+  rapidjson::FileReadStream is( f.get(), buffer.data(), buffer.size() );
+  DocumentHandler handler( is, callback );
+  rapidjson::Reader reader;
+  return not reader.Parse( is, handler ).IsError();
+}
+
 bool
 Documents::serialize( rapidjson::Writer<rapidjson::StringBuffer>* writer )
 const
@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include <functional>
+
 #include "jsonbase.hpp"
 
 namespace piac {
@@ -92,6 +94,11 @@ class Documents : public JSONBase {
     bool serialize( rapidjson::Writer<rapidjson::StringBuffer>* writer )
       const override;
 
+    //! Stream documents from JSON in file, calling a function on each
+    static bool
+    stream( const std::string& filePath,
+            const std::function< void( Document&&, std::size_t ) >& callback );
+
     [[nodiscard]] std::string serialize() const override {
       return JSONBase::serialize();
     }
@@ -0,0 +1,134 @@
+// *****************************************************************************
+/*!
+  \file      src/hash256.cpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac fixed-size binary hash and flat set of hashes
+*/
+// *****************************************************************************
+
+#include <algorithm>
+
+#include "hash256.hpp"
+
+using piac::HashSet;
+
+//! Minimum number of slots allocated once the set is not empty
+static const std::size_t MIN_SLOTS = 16;
+
+bool
+HashSet::insert( const Hash256& h )
+// *****************************************************************************
+//  Insert hash
+//! \param[in] h Hash to insert, the all-zero hash is not inserted
+//! \return True if the hash was not yet in the set
+// *****************************************************************************
+{
+  if (h.zero()) return false;
+  // Grow when the load factor would exceed 3/4
+  if (4 * (m_size + 1) > 3 * m_slots.size())
+    rehash( m_slots.empty() ? MIN_SLOTS : 2 * m_slots.size() );
+
+  const auto mask = m_slots.size() - 1;
+  for (auto i = home( h ); ; i = (i + 1) & mask) {
+    auto& s = m_slots[i];
+    if (s == h) return false;
+    if (s.zero()) {
+      s = h;
+      ++m_size;
+      return true;
+    }
+  }
+}
+
+bool
+HashSet::erase( const Hash256& h )
+// *****************************************************************************
+//  Erase hash
+//! \param[in] h Hash to erase
+//! \return True if the hash was in the set
+//! \details Entries following the erased one in its probe sequence are moved
+//!   back into the hole if their home slot allows, so lookups never have to
+//!   skip deleted entries.
+// *****************************************************************************
+{
+  if (m_size == 0 || h.zero()) return false;
+
+  const auto mask = m_slots.size() - 1;
+  auto i = home( h );
+  while (m_slots[i] != h) {
+    if (m_slots[i].zero()) return false;
+    i = (i + 1) & mask;
+  }
+
+  for (auto j = (i + 1) & mask; not m_slots[j].zero(); j = (j + 1) & mask) {
+    // Move entry at j into the hole at i unless its home is cyclically in (i,j]
+    const auto k = home( m_slots[j] );
+    if (((j - k) & mask) >= ((j - i) & mask)) {
+      m_slots[i] = m_slots[j];
+      i = j;
+    }
+  }
+  m_slots[i] = Hash256();
+  --m_size;
+  return true;
+}
+
+bool
+HashSet::contains( const Hash256& h ) const
+// *****************************************************************************
+//  Find hash
+//! \param[in] h Hash to find
+//! \return True if the hash is in the set
+// *****************************************************************************
+{
+  if (m_size == 0 || h.zero()) return false;
+
+  const auto mask = m_slots.size() - 1;
+  for (auto i = home( h ); ; i = (i + 1) & mask) {
+    const auto& s = m_slots[i];
+    if (s == h) return true;
+    if (s.zero()) return false;
+  }
+}
+
+void
+HashSet::clear()
+// *****************************************************************************
+//  Remove all hashes, keeping the table allocated
+// *****************************************************************************
+{
+  std::fill( m_slots.begin(), m_slots.end(), Hash256() );
+  m_size = 0;
+}
+
+void
+HashSet::reserve( std::size_t n )
+// *****************************************************************************
+//  Make room for at least n hashes without growing the table
+//! \param[in] n Number of hashes to make room for
+// *****************************************************************************
+{
+  auto slots = m_slots.empty() ? MIN_SLOTS : m_slots.size();
+  while (4 * n > 3 * slots) slots *= 2;
+  if (slots != m_slots.size()) rehash( slots );
+}
+
+void
+HashSet::rehash( std::size_t n )
+// *****************************************************************************
+//  Rehash all entries into a new table
+//! \param[in] n Number of slots of new table, a power of two
+// *****************************************************************************
+{
+  assert( n && (n & (n - 1)) == 0 && 4 * m_size <= 3 * n );
+  std::vector< Hash256 > slots( n );
+  slots.swap( m_slots );
+  const auto mask = n - 1;
+  for (const auto& h : slots) {
+    if (h.zero()) continue;
+    auto i = home( h );
+    while (not m_slots[i].zero()) i = (i + 1) & mask;
+    m_slots[i] = h;
+  }
+}
@@ -0,0 +1,170 @@
+// *****************************************************************************
+/*!
+  \file      src/hash256.hpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac fixed-size binary hash and flat set of hashes
+*/
+// *****************************************************************************
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+
+namespace piac {
+
+//! Binary sha256 hash, e.g., of a document, stored inline as 32 bytes
+class Hash256 {
+  public:
+    //! Number of bytes in a hash
+    static constexpr std::size_t SIZE = 32;
+
+    //! Constructor: all-zero hash
+    Hash256() : m_bytes{} {}
+
+    //! Constructor: from raw (not hex-encoded) hash of SIZE bytes
+    //! \details A string of any other size, e.g., received malformed from a
+    //!   peer, yields the all-zero hash, which HashSet never stores.
+    explicit Hash256( const std::string& raw ) : m_bytes{} {
+      if (raw.size() == SIZE) std::memcpy( m_bytes.data(), raw.data(), SIZE );
+    }
+
+    //! Raw bytes of hash
+    const std::uint8_t* data() const { return m_bytes.data(); }
+    std::uint8_t* data() { return m_bytes.data(); }
+
+    //! Return raw hash as a string of SIZE bytes
+    std::string str() const {
+      return std::string( reinterpret_cast< const char* >( m_bytes.data() ),
+                          SIZE );
+    }
+
+    //! True if all bytes are zero, reserved to mark empty slots in HashSet
+    bool zero() const {
+      static const std::array< std::uint8_t, SIZE > z{};
+      return m_bytes == z;
+    }
+
+    bool operator==( const Hash256& h ) const { return m_bytes == h.m_bytes; }
+    bool operator!=( const Hash256& h ) const { return m_bytes != h.m_bytes; }
+    bool operator<( const Hash256& h ) const { return m_bytes < h.m_bytes; }
+
+    //! Combine with another hash byte-wise by exclusive or
+    Hash256& operator^=( const Hash256& h ) {
+      for (std::size_t i = 0; i < SIZE; ++i) m_bytes[i] ^= h.m_bytes[i];
+      return *this;
+    }
+
+    //! Hasher for unordered containers
+    //! \details The bytes are already the output of a cryptographic hash, so
+    //!   the first few of them are used as is.
+    struct Hasher {
+      std::size_t operator()( const Hash256& h ) const {
+        std::size_t s;
+        std::memcpy( &s, h.m_bytes.data(), sizeof(s) );
+        return s;
+      }
+    };
+
+  private:
+    //! Raw bytes of hash
+    std::array< std::uint8_t, SIZE > m_bytes;
+};
+
+//! Set of hashes stored in a flat open-addressing table
+//! \details Hashes are stored inline in a single array, probed linearly, so a
+//!   hash costs 32 bytes divided by the load factor (kept between 3/8 and 3/4)
+//!   and a lookup is usually a single cache miss, compared to a node
+//!   allocation, a heap-allocated string and a pointer chase per hash in a
+//!   std::unordered_set< std::string >. The all-zero hash marks empty slots
+//!   and cannot be stored. Erasing shifts subsequent entries of the probe
+//!   sequence back, so no tombstones accumulate. Inserting or erasing
+//!   invalidates iterators.
+class HashSet {
+  public:
+    //! Iterator over hashes in the set, in unspecified order
+    class const_iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Hash256;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Hash256*;
+        using reference = const Hash256&;
+        const_iterator( const Hash256* p, const Hash256* e ) : m_p(p), m_e(e)
+        { skip(); }
+        const Hash256& operator*() const { return *m_p; }
+        const Hash256* operator->() const { return m_p; }
+        const_iterator& operator++() { ++m_p; skip(); return *this; }
+        bool operator==( const const_iterator& i ) const { return m_p == i.m_p; }
+        bool operator!=( const const_iterator& i ) const { return m_p != i.m_p; }
+      private:
+        //! Advance to next occupied slot
+        void skip() { while (m_p != m_e && m_p->zero()) ++m_p; }
+        const Hash256* m_p;
+        const Hash256* m_e;
+    };
+
+    //! Insert hash, return true if it was not yet in the set
+    bool insert( const Hash256& h );
+    bool insert( const std::string& raw ) {
+      return raw.size() == Hash256::SIZE && insert( Hash256( raw ) );
+    }
+
+    //! Erase hash, return true if it was in the set
+    bool erase( const Hash256& h );
+    bool erase( const std::string& raw ) {
+      return raw.size() == Hash256::SIZE && erase( Hash256( raw ) );
+    }
+
+    //! Return true if hash is in the set
+    bool contains( const Hash256& h ) const;
+    bool contains( const std::string& raw ) const {
+      return raw.size() == Hash256::SIZE && contains( Hash256( raw ) );
+    }
+
+    //! Number of hashes in the set
+    std::size_t size() const { return m_size; }
+
+    //! True if the set is empty
+    bool empty() const { return m_size == 0; }
+
+    //! Remove all hashes, keeping the table allocated
+    void clear();
+
+    //! Make room for at least n hashes without growing the table
+    void reserve( std::size_t n );
+
+    //! Number of bytes allocated for the table
+    std::size_t bytes() const { return m_slots.capacity() * sizeof(Hash256); }
+
+    const_iterator begin() const {
+      return { m_slots.data(), m_slots.data() + m_slots.size() };
+    }
+    const_iterator end() const {
+      const auto e = m_slots.data() + m_slots.size();
+      return { e, e };
+    }
+
+  private:
+    //! Slot a hash is first probed at
+    std::size_t home( const Hash256& h ) const {
+      return Hash256::Hasher()( h ) & (m_slots.size() - 1);
+    }
+
+    //! Rehash all entries into a table of n slots, n a power of two
+    void rehash( std::size_t n );
+
+    //! Slots, size zero or a power of two, all-zero hash: empty
+    std::vector< Hash256 > m_slots;
+    //! Number of hashes in the set
+    std::size_t m_size = 0;
+};
+
+} // piac::
@@ -0,0 +1,221 @@
+// *****************************************************************************
+/*!
+  \file      src/index_schema.cpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac index schema configuring how document fields are indexed
+*/
+// *****************************************************************************
+
+#include <sstream>
+#include <unordered_set>
+
+#include "logging_util.hpp"
+#include "index_schema.hpp"
+
+using piac::IndexSchema;
+
+namespace piac {
+
+static const std::string&
+text( const Document& ndoc, const std::string& name )
+// *****************************************************************************
+//! Return text field of a document by name
+//! \param[in] ndoc Document whose field to return
+//! \param[in] name Name of field
+//! \return Text of field
+// *****************************************************************************
+{
+  if (name == "title") return ndoc.title();
+  if (name == "description") return ndoc.description();
+  if (name == "category") return ndoc.category();
+  if (name == "condition") return ndoc.condition();
+  if (name == "shipping") return ndoc.shipping();
+  if (name == "format") return ndoc.format();
+  if (name == "location") return ndoc.location();
+  assert( name == "keywords" );
+  return ndoc.keywords();
+}
+
+} // piac::
+
+IndexSchema::IndexSchema() :
+  m_fields{ { "title", "S" },
+            { "description", "XD" },
+            { "category", "XC" },
+            { "condition", "XO" },
+            { "shipping", "XS" },
+            { "format", "XF" },
+            { "location", "XL" },
+            { "keywords", "K" } }
+// *****************************************************************************
+//  Constructor: default schema
+//! \details All text fields are indexed both with and without prefix, with
+//!   positional information, and weight 1.
+// *****************************************************************************
+{
+}
+
+bool
+IndexSchema::deserialize( const rapidjson::Value& obj )
+// *****************************************************************************
+//  Deserialize schema from JSON object
+//! \param[in] obj Input JSON object
+//! \return True if no error occurred, false if the schema is invalid in which
+//!   case the schema is left unchanged
+// *****************************************************************************
+{
+  static const std::unordered_set< std::string > names{
+    "title", "description", "category", "condition", "shipping", "format",
+    "location", "keywords" };
+
+  if (not obj.IsObject() || not obj.HasMember( "fields" ) ||
+      not obj["fields"].IsArray())
+  {
+    MERROR( "Index schema must be an object with an array of fields" );
+    return false;
+  }
+
+  std::vector< Field > fields;
+  std::unordered_set< std::string > prefixes;
+  for (auto f = obj["fields"].Begin(); f != obj["fields"].End(); ++f) {
+    if (not f->IsObject() || not f->HasMember( "name" ) ||
+        not f->HasMember( "prefix" ))
+    {
+      MERROR( "Index schema field needs a name and a prefix" );
+      return false;
+    }
+    Field e;
+    e.name = (*f)["name"].GetString();
+    e.prefix = (*f)["prefix"].GetString();
+    if (names.find( e.name ) == end(names)) {
+      MERROR( "Index schema: no text field " << e.name );
+      return false;
+    }
+    if (e.prefix.empty() || not prefixes.insert( e.prefix ).second ||
+        e.prefix == "A" || e.prefix == "Q")
+    {
+      MERROR( "Index schema: prefix of " << e.name << " must be unique and "
+              "not A or Q" );
+      return false;
+    }
+    if (f->HasMember( "prefixed" )) e.prefixed = (*f)["prefixed"].GetBool();
+    if (f->HasMember( "unprefixed" ))
+      e.unprefixed = (*f)["unprefixed"].GetBool();
+    if (f->HasMember( "positional" ))
+      e.positional = (*f)["positional"].GetBool();
+    if (f->HasMember( "boolean" )) e.boolean = (*f)["boolean"].GetBool();
+    if (f->HasMember( "weight" )) e.weight = (*f)["weight"].GetUint();
+    fields.push_back( std::move(e) );
+  }
+
+  m_fields = std::move( fields );
+  return true;
+}
+
+bool
+IndexSchema::serialize( rapidjson::Writer<rapidjson::StringBuffer>* writer )
+const
+// *****************************************************************************
+//  Serialize schema to JSON format
+//! \param[in] writer Pointer to rapidjson write object to write object to
+//! \return True if no error occurred
+// *****************************************************************************
+{
+  writer->StartObject();
+  writer->String( "fields" );
+  writer->StartArray();
+  for (const auto& f : m_fields) {
+    writer->StartObject();
+    writer->String( "name" );       writer->String( f.name.c_str() );
+    writer->String( "prefix" );     writer->String( f.prefix.c_str() );
+    writer->String( "prefixed" );   writer->Bool( f.prefixed );
+    writer->String( "unprefixed" ); writer->Bool( f.unprefixed );
+    writer->String( "positional" ); writer->Bool( f.positional );
+    writer->String( "boolean" );    writer->Bool( f.boolean );
+    writer->String( "weight" );     writer->Uint( f.weight );
+    writer->EndObject();
+  }
+  writer->EndArray();
+  writer->EndObject();
+  return true;
+}
+
+void
+IndexSchema::index( Xapian::TermGenerator& indexer,
+                    Xapian::Document& doc,
+                    const Document& ndoc ) const
+// *****************************************************************************
+//  Index text fields of a document
+//! \param[in,out] indexer Xapian indexer to use
+//! \param[in,out] doc Xapian document to add terms to
+//! \param[in] ndoc Document whose fields to index
+// *****************************************************************************
+{
+  indexer.set_document( doc );
+  // Index each field with its prefix
+  for (const auto& f : m_fields) {
+    const auto& t = text( ndoc, f.name );
+    if (f.boolean) {
+      if (not t.empty()) doc.add_boolean_term( f.prefix + t );
+    } else if (f.prefixed) {
+      if (f.positional)
+        indexer.index_text( t, f.weight, f.prefix );
+      else
+        indexer.index_text_without_positions( t, f.weight, f.prefix );
+    }
+  }
+  // Index fields without prefixes for general search
+  bool first = true;
+  for (const auto& f : m_fields) {
+    if (f.boolean || not f.unprefixed) continue;
+    const auto& t = text( ndoc, f.name );
+    if (f.positional) {
+      if (not first) indexer.increase_termpos();
+      indexer.index_text( t, f.weight );
+    } else {
+      indexer.index_text_without_positions( t, f.weight );
+    }
+    first = false;
+  }
+}
+
+void
+IndexSchema::configure( Xapian::QueryParser& parser ) const
+// *****************************************************************************
+//  Configure query parser to search fields by name
+//! \param[in,out] parser Query parser to configure
+// *****************************************************************************
+{
+  for (const auto& f : m_fields) {
+    if (f.boolean)
+      parser.add_boolean_prefix( f.name, f.prefix );
+    else if (f.prefixed)
+      parser.add_prefix( f.name, f.prefix );
+  }
+}
+
+std::string
+IndexSchema::summary() const
+// *****************************************************************************
+//  Return a human-readable summary of the schema
+//! \return Summary listing how each field is indexed
+// *****************************************************************************
+{
+  std::stringstream s;
+  for (const auto& f : m_fields) {
+    s << f.name << ':' << f.prefix;
+    if (f.boolean) {
+      s << " boolean";
+    } else {
+      if (f.prefixed) s << " prefixed";
+      if (f.unprefixed) s << " unprefixed";
+      if (f.positional) s << " positional";
+      s << " weight " << f.weight;
+    }
+    s << "; ";
+  }
+  auto r = s.str();
+  if (r.size() > 1) r.erase( r.size() - 2 );
+  return r;
+}
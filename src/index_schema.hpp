@@ -0,0 +1,99 @@
+// *****************************************************************************
+/*!
+  \file      src/index_schema.hpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac index schema configuring how document fields are indexed
+*/
+// *****************************************************************************
+
+#pragma once
+
+#include <vector>
+
+#if defined(__clang__)
+  #pragma clang diagnostic push
+  #pragma clang diagnostic ignored "-W#warnings"
+#endif
+
+#include "xapian.h"
+
+#if defined(__clang__)
+  #pragma clang diagnostic pop
+#endif
+
+#include "document.hpp"
+
+namespace piac {
+
+//! Index schema configuring how the text fields of documents are indexed
+//! \details The schema is given in JSON as an array of fields, e.g.,
+//!   \code{.json}
+//!   { "fields": [
+//!     { "name": "title", "prefix": "S", "prefixed": true,
+//!       "unprefixed": true, "positional": true, "weight": 2 },
+//!     { "name": "category", "prefix": "XC", "boolean": true } ] }
+//!   \endcode
+//!   Fields not listed are not indexed. A prefixed field can be searched for
+//!   as name:word, an unprefixed field is searched by plain words, positional
+//!   fields enable phrase and proximity search, and a boolean field is only
+//!   indexed as a single filter term of its whole value, searchable as
+//!   name:value. The default schema indexes all text fields prefixed and
+//!   unprefixed with positions and weight 1.
+class IndexSchema : public JSONBase {
+  public:
+    //! Indexing configuration of a document field
+    struct Field {
+      //! Name of document field
+      std::string name;
+      //! Term prefix
+      std::string prefix;
+      //! True to index with prefix
+      bool prefixed = true;
+      //! True to index without prefix for general search
+      bool unprefixed = true;
+      //! True to store term positions
+      bool positional = true;
+      //! True to only index the whole value as a boolean term with prefix
+      bool boolean = false;
+      //! Within-document frequency increment per term, i.e., weight
+      Xapian::termcount weight = 1;
+    };
+
+    //! Constructor: default schema
+    IndexSchema();
+
+    //! Deserialize schema from JSON object
+    bool deserialize( const rapidjson::Value& obj ) override;
+
+    bool deserialize( const std::string& s ) override {
+      return JSONBase::deserialize( s );
+    }
+
+    bool serialize( rapidjson::Writer<rapidjson::StringBuffer>* writer )
+      const override;
+
+    [[nodiscard]] std::string serialize() const override {
+      return JSONBase::serialize();
+    }
+
+    //! Fields indexed
+    const std::vector< Field >& fields() const { return m_fields; }
+
+    //! Index text fields of a document
+    void index( Xapian::TermGenerator& indexer,
+                Xapian::Document& doc,
+                const Document& ndoc ) const;
+
+    //! Configure query parser to search fields by name
+    void configure( Xapian::QueryParser& parser ) const;
+
+    //! Return a human-readable summary of the schema
+    std::string summary() const;
+
+  private:
+    //! Fields indexed
+    std::vector< Field > m_fields;
+};
+
+} // piac::
@@ -81,6 +81,5 @@ JSONBase::initDocument( const std::string& s, rapidjson::Document& doc ) const
 // *****************************************************************************
 {
   if (s.empty()) return false;
-  std::string validJson( s );
-  return not doc.Parse( validJson.c_str() ).HasParseError() ? true : false;
+  return not doc.Parse( s.data(), s.size() ).HasParseError();
 }
@@ -0,0 +1,253 @@
+// *****************************************************************************
+/*!
+  \file      src/liveness.cpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac liveness of peers tracked by heartbeats
+*/
+// *****************************************************************************
+
+#include <map>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "liveness.hpp"
+
+namespace piac {
+
+static long
+elapsed_ms( Liveness::clock::time_point from, Liveness::clock::time_point to )
+// *****************************************************************************
+//! Milliseconds elapsed between two time points
+//! \param[in] from Time point to measure from
+//! \param[in] to Time point to measure to
+//! \return Milliseconds elapsed, negative if to precedes from
+// *****************************************************************************
+{
+  return static_cast< long >(
+    std::chrono::duration_cast< std::chrono::milliseconds >( to - from )
+      .count() );
+}
+
+} // piac::
+
+using piac::Liveness;
+
+Liveness::Liveness( double timeout ) :
+  m_timeout_ms( std::max( 1L, static_cast< long >( timeout * 1000.0 ) ) ),
+  m_heartbeat_ms( std::max( 1L, std::min( PEER_HEARTBEAT_MS,
+                                          m_timeout_ms / 3 ) ) )
+// *****************************************************************************
+//  Constructor
+//! \param[in] timeout Seconds without hearing from a peer it is considered dead
+//! \details Heartbeats are sent often enough for a live peer to answer at
+//!   least a few of them within the timeout.
+// *****************************************************************************
+{
+}
+
+void
+Liveness::add( const std::string& addr, clock::time_point now )
+// *****************************************************************************
+//  Start tracking a peer connected to, unless already tracked
+//! \param[in] addr Address of peer
+//! \param[in] now Time the peer is connected to
+//! \details A new peer is given the timeout to answer from the time connected.
+// *****************************************************************************
+{
+  auto [p, inserted] = m_peers.try_emplace( addr );
+  if (inserted) p->second.heard = now;
+}
+
+bool
+Liveness::heard( const std::string& addr, clock::time_point now )
+// *****************************************************************************
+//  Record that a peer was heard from
+//! \param[in] addr Address of peer
+//! \param[in] now Time the peer was heard from
+//! \return True if the peer was dead and is now alive again, to reconnect to
+// *****************************************************************************
+{
+  auto p = m_peers.find( addr );
+  if (p == end(m_peers)) return false;
+
+  auto& s = p->second;
+  bool revived = not s.alive;
+  s.alive = true;
+  s.heard = now;
+  s.backoff_ms = 0;
+  return revived;
+}
+
+bool
+Liveness::ping( const std::string& addr,
+                std::uint64_t& seq,
+                clock::time_point now )
+// *****************************************************************************
+//  Take the sequence number of the next heartbeat to a peer if due
+//! \param[in] addr Address of peer
+//! \param[out] seq Sequence number of heartbeat to send
+//! \param[in] now Time the heartbeat is sent
+//! \return True if a heartbeat is due, false if not or if the peer is dead
+// *****************************************************************************
+{
+  auto p = m_peers.find( addr );
+  if (p == end(m_peers)) return false;
+
+  auto& s = p->second;
+  if (not s.alive || (s.ping && elapsed_ms( s.pinged, now ) < m_heartbeat_ms))
+    return false;
+
+  seq = ++s.ping;
+  s.pinged = now;
+  return true;
+}
+
+bool
+Liveness::pong( const std::string& addr,
+                std::uint64_t seq,
+                clock::time_point now )
+// *****************************************************************************
+//  Record answer to a heartbeat and update round-trip time
+//! \param[in] addr Address of peer
+//! \param[in] seq Sequence number of heartbeat answered
+//! \param[in] now Time the answer arrived
+//! \return True if the peer was dead and is now alive again, to reconnect to
+//! \details Only the answer to the last heartbeat sent is timed, answers to
+//!   earlier ones, which arrive late, only show that the peer is alive. The
+//!   round-trip time is smoothed as TCP does, see RFC 6298.
+// *****************************************************************************
+{
+  auto p = m_peers.find( addr );
+  if (p == end(m_peers)) return false;
+
+  auto& s = p->second;
+  if (seq == s.ping) {
+    auto sample = std::chrono::duration< double, std::milli >(
+                    now - s.pinged ).count();
+    s.rtt = s.rtt < 0.0 ? sample : 0.875 * s.rtt + 0.125 * sample;
+  }
+  return heard( addr, now );
+}
+
+std::vector< std::string >
+Liveness::expire( clock::time_point now )
+// *****************************************************************************
+//  Declare dead peers not heard from within the timeout
+//! \param[in] now Current time
+//! \return Addresses of peers that died, whose sockets to close
+// *****************************************************************************
+{
+  std::vector< std::string > died;
+  for (auto& [addr,s] : m_peers) {
+    if (not s.alive || elapsed_ms( s.heard, now ) <= m_timeout_ms) continue;
+    if (s.backoff_ms == 0) {
+      s.down = now;
+      s.backoff_ms = m_heartbeat_ms;
+    } else {
+      s.backoff_ms = std::min( 2 * s.backoff_ms, PEER_BACKOFF_MAX_MS );
+    }
+    s.alive = false;
+    s.rtt = -1.0;
+    s.retry = now + std::chrono::milliseconds( s.backoff_ms );
+    died.push_back( addr );
+  }
+  return died;
+}
+
+std::vector< std::string >
+Liveness::retry( clock::time_point now )
+// *****************************************************************************
+//  Take dead peers due to be reconnected to
+//! \param[in] now Current time
+//! \return Addresses of peers to reconnect to
+//! \details A peer reconnected to is alive again on probation: it is given the
+//!   timeout to answer, after which it dies again with its backoff doubled.
+// *****************************************************************************
+{
+  std::vector< std::string > due;
+  for (auto& [addr,s] : m_peers) {
+    if (s.alive || now < s.retry) continue;
+    s.alive = true;
+    s.heard = now;
+    due.push_back( addr );
+  }
+  return due;
+}
+
+std::vector< std::string >
+Liveness::forget( clock::time_point now )
+// *****************************************************************************
+//  Stop tracking peers dead for too long
+//! \param[in] now Current time
+//! \return Addresses of peers forgotten
+// *****************************************************************************
+{
+  std::vector< std::string > gone;
+  for (auto p = begin(m_peers); p != end(m_peers); ) {
+    const auto& s = p->second;
+    if (not s.alive && elapsed_ms( s.down, now ) > PEER_FORGET_MS) {
+      gone.push_back( p->first );
+      p = m_peers.erase( p );
+    } else {
+      ++p;
+    }
+  }
+  return gone;
+}
+
+bool
+Liveness::dead( const std::string& addr ) const
+// *****************************************************************************
+//  True if the peer is tracked and dead
+//! \param[in] addr Address of peer
+//! \return True if dead, false if alive or not tracked
+// *****************************************************************************
+{
+  auto p = m_peers.find( addr );
+  return p != end(m_peers) && not p->second.alive;
+}
+
+const Liveness::Peer*
+Liveness::find( const std::string& addr ) const
+// *****************************************************************************
+//  Liveness of a peer, nullptr if not tracked
+//! \param[in] addr Address of peer
+//! \return Pointer to liveness of peer, nullptr if not tracked
+// *****************************************************************************
+{
+  auto p = m_peers.find( addr );
+  return p != end(m_peers) ? &p->second : nullptr;
+}
+
+std::string
+Liveness::status( clock::time_point now ) const
+// *****************************************************************************
+//  Summary of the liveness of all peers, one line per peer
+//! \param[in] now Current time
+//! \return Summary as a string, empty if no peers
+// *****************************************************************************
+{
+  std::map< std::string, const Peer* > sorted;
+  for (const auto& [addr,s] : m_peers) sorted.emplace( addr, &s );
+
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(2);
+  bool first = true;
+  for (const auto& [addr,s] : sorted) {
+    if (not first) ss << '\n';
+    first = false;
+    ss << addr;
+    if (not s->alive) {
+      ss << " dead for " << elapsed_ms( s->down, now ) / 1000 << " s, retry in "
+         << std::max( 0L, elapsed_ms( now, s->retry ) ) / 1000 << " s";
+    } else if (s->rtt < 0.0) {
+      ss << (s->backoff_ms ? " reconnecting" : " connecting");
+    } else {
+      ss << " alive, rtt " << s->rtt << " ms, last heard "
+         << elapsed_ms( s->heard, now ) / 1000 << " s ago";
+    }
+  }
+  return ss.str();
+}
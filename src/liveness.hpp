@@ -0,0 +1,115 @@
+// *****************************************************************************
+/*!
+  \file      src/liveness.hpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac liveness of peers tracked by heartbeats
+*/
+// *****************************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+namespace piac {
+
+//! Default number of seconds without hearing from a peer it is considered dead
+const double DEFAULT_PEER_TIMEOUT = 30;
+//! Milliseconds between heartbeats sent to a peer, at most
+const long PEER_HEARTBEAT_MS = 5000;
+//! Longest time in milliseconds to wait before reconnecting to a dead peer
+const long PEER_BACKOFF_MAX_MS = 10 * 60 * 1000;
+//! Milliseconds a peer may stay dead after which it is forgotten
+const long PEER_FORGET_MS = 24 * 60 * 60 * 1000;
+//! Maximum number of messages queued to and from a peer's socket
+const int PEER_HWM = 1000;
+
+//! Liveness of peers tracked by heartbeats
+//! \details Peers are sent a heartbeat at regular intervals, which they answer
+//!   by echoing its sequence number, giving the round-trip time. A peer not
+//!   heard from within the timeout is dead: its socket is closed, so nothing
+//!   is queued for it, and it is reconnected to after a backoff that doubles
+//!   with every reconnect it does not answer, up to PEER_BACKOFF_MAX_MS. A
+//!   peer dead for longer than PEER_FORGET_MS is forgotten. Hearing from a
+//!   dead peer, e.g., a heartbeat of its own, revives it right away.
+class Liveness {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    //! Liveness of a peer
+    struct Peer {
+      //! False while the peer is dead, waiting to be reconnected to
+      bool alive = true;
+      //! Time the peer was last heard from
+      clock::time_point heard;
+      //! Time the last heartbeat was sent
+      clock::time_point pinged;
+      //! Sequence number of the last heartbeat sent
+      std::uint64_t ping = 0;
+      //! Smoothed round-trip time in milliseconds, negative if not yet known
+      double rtt = -1.0;
+      //! Milliseconds to wait before reconnecting, zero if never died
+      long backoff_ms = 0;
+      //! Time the peer first died since it was last heard from
+      clock::time_point down;
+      //! Time to reconnect to a dead peer
+      clock::time_point retry;
+    };
+
+    //! Constructor
+    explicit Liveness( double timeout = DEFAULT_PEER_TIMEOUT );
+
+    //! Start tracking a peer connected to, unless already tracked
+    void add( const std::string& addr, clock::time_point now = clock::now() );
+
+    //! Stop tracking a peer, e.g., no longer connected to
+    void remove( const std::string& addr ) { m_peers.erase( addr ); }
+
+    //! Record that a peer was heard from
+    bool heard( const std::string& addr, clock::time_point now = clock::now() );
+
+    //! Take the sequence number of the next heartbeat to a peer if due
+    bool ping( const std::string& addr,
+               std::uint64_t& seq,
+               clock::time_point now = clock::now() );
+
+    //! Record answer to a heartbeat and update round-trip time
+    bool pong( const std::string& addr,
+               std::uint64_t seq,
+               clock::time_point now = clock::now() );
+
+    //! Declare dead peers not heard from within the timeout
+    std::vector< std::string > expire( clock::time_point now = clock::now() );
+
+    //! Take dead peers due to be reconnected to
+    std::vector< std::string > retry( clock::time_point now = clock::now() );
+
+    //! Stop tracking peers dead for too long
+    std::vector< std::string > forget( clock::time_point now = clock::now() );
+
+    //! True if the peer is tracked and dead
+    bool dead( const std::string& addr ) const;
+
+    //! Liveness of a peer, nullptr if not tracked
+    const Peer* find( const std::string& addr ) const;
+
+    //! Summary of the liveness of all peers, one line per peer
+    std::string status( clock::time_point now = clock::now() ) const;
+
+    //! Number of peers tracked
+    std::size_t size() const { return m_peers.size(); }
+
+  private:
+    //! Milliseconds without hearing from a peer it is considered dead
+    long m_timeout_ms;
+    //! Milliseconds between heartbeats
+    long m_heartbeat_ms;
+    //! Liveness of peers associated to their addresses
+    std::unordered_map< std::string, Peer > m_peers;
+};
+
+} // piac::
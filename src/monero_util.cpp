@@ -7,8 +7,13 @@
 */
 // *****************************************************************************
 
+#include <fstream>
+#include <ctime>
+
 #include "string_util.hpp"
 #include "crypto_util.hpp"
+#include "signature.hpp"
+#include "tombstone.hpp"
 #include "monero_util.hpp"
 
 void
@@ -45,22 +50,58 @@ piac::send_cmd( std::string cmd,
   trim( cmd );
   MDEBUG( cmd );
 
-  // append author if cmd contains "db add/rm"
+  // append author if cmd is "db add/rm/list mine"
   auto npos = std::string::npos;
-  if ( cmd.find("db") != npos &&
-      (cmd.find("add") != npos || cmd.find("rm") != npos) )
+  auto words = tokenize( cmd );
+  std::string auth;
+  if (words.size() > 1 && words[0] == "db" &&
+      (words[1] == "add" || words[1] == "rm" ||
+       (words[1] == "list" && words.size() > 2 && words[2] == "mine")))
   {
     if (not wallet) {
       std::cout << "Need active user id (wallet) to add to db. "
                    "See 'new' or 'user'.\n";
       return;
     }
-    cmd += " AUTH:" + piac::sha256( wallet->get_primary_address() );
+    auth = " AUTH:" + piac::sha256( wallet->get_primary_address() );
+  }
+
+  // sign tombstones of documents to remove, hashes listed or read from file
+  std::string sign;
+  if (not auth.empty() && words[1] == "rm") {
+    std::vector< std::string > hashes( begin(words) + 2, end(words) );
+    if (hashes.size() == 2 && hashes[0] == "file") {
+      std::ifstream f( hashes[1] );
+      hashes.clear();
+      for (std::string h; f >> h; ) hashes.push_back( std::move(h) );
+    }
+    Tombstone t;
+    t.time = static_cast< std::int64_t >( std::time( nullptr ) );
+    auto sec = wallet->get_private_spend_key();
+    auto pub = wallet->get_public_spend_key();
+    sign = " SIGN:" + wallet->get_primary_address() + ' ' +
+           std::to_string( t.time );
+    for (const auto& h : hashes) {
+      t.hash = unhex( h );
+      sign += ' ' + h + ':' + sign_message( sec, pub, t.message() );
+    }
   }
 
-  // send message to daemon with command
-  auto reply = pirate_send( cmd, ctx, host, rpc_server_public_key, client_keys );
-  std::cout << reply << '\n';
+  // send message to daemon with command, print reply, and for list commands
+  // request the next chunk as long as the reply ends with a continuation token
+  bool list = cmd.rfind( "db list", 0 ) == 0;
+  std::string after;
+  do {
+    auto reply = pirate_send( cmd + after + sign + auth, ctx, host,
+                              rpc_server_public_key, client_keys );
+    after.clear();
+    auto c = reply.rfind( "Continue: " );
+    if (list && c != npos && (c == 0 || reply[c-1] == '\n')) {
+      after = " --after " + reply.substr( c + 10 );
+      reply.erase( c ? c - 1 : 0 );
+    }
+    if (not reply.empty()) std::cout << reply << '\n';
+  } while (not after.empty());
 }
 
 void
@@ -0,0 +1,102 @@
+// *****************************************************************************
+/*!
+  \file      src/overlay.cpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac bounded-degree membership of the peer-to-peer overlay
+*/
+// *****************************************************************************
+
+#include <algorithm>
+
+#include "overlay.hpp"
+
+using piac::Overlay;
+
+Overlay::Overlay( std::size_t fanout ) :
+  m_fanout( std::max< std::size_t >( fanout, 1 ) ),
+  m_gen( std::random_device{}() )
+// *****************************************************************************
+//  Constructor
+//! \param[in] fanout Number of peers, besides the one an event came from,
+//!   forwarded to, at least 1
+// *****************************************************************************
+{
+}
+
+void
+Overlay::learn( const std::string& addr )
+// *****************************************************************************
+//  Remember address of peer in the passive view, unless already there
+//! \param[in] addr Address of peer, not in the active view
+//! \details If the passive view is full, a random address is replaced, so the
+//!   passive view stays a random sample of the addresses learned.
+// *****************************************************************************
+{
+  if (std::find( begin(m_passive), end(m_passive), addr ) != end(m_passive))
+    return;
+
+  if (m_passive.size() < PASSIVE_VIEW)
+    m_passive.push_back( addr );
+  else
+    m_passive[ random( m_passive.size() ) ] = addr;
+}
+
+void
+Overlay::forget( const std::string& addr )
+// *****************************************************************************
+//  Remove address of peer from the passive view
+//! \param[in] addr Address of peer
+// *****************************************************************************
+{
+  m_passive.erase( std::remove( begin(m_passive), end(m_passive), addr ),
+                   end(m_passive) );
+}
+
+bool
+Overlay::pick( std::string& addr )
+// *****************************************************************************
+//  Take a random address of peer from the passive view
+//! \param[out] addr Address of peer taken
+//! \return False if the passive view is empty
+// *****************************************************************************
+{
+  if (m_passive.empty()) return false;
+
+  auto i = random( m_passive.size() );
+  addr = std::move( m_passive[i] );
+  m_passive[i] = std::move( m_passive.back() );
+  m_passive.pop_back();
+  return true;
+}
+
+std::vector< std::string >
+Overlay::sample( std::vector< std::string > active )
+// *****************************************************************************
+//  Random sample of addresses of peers active and passive to advertise
+//! \param[in] active Addresses of peers in the active view
+//! \return At most PEER_SAMPLE addresses, active ones first
+// *****************************************************************************
+{
+  std::shuffle( begin(active), end(active), m_gen );
+  if (active.size() > PEER_SAMPLE / 2) active.resize( PEER_SAMPLE / 2 );
+
+  auto passive = m_passive;
+  std::shuffle( begin(passive), end(passive), m_gen );
+  for (auto& p : passive) {
+    if (active.size() == PEER_SAMPLE) break;
+    active.push_back( std::move(p) );
+  }
+  return active;
+}
+
+std::size_t
+Overlay::random( std::size_t n )
+// *****************************************************************************
+//  Random integer in [0,n)
+//! \param[in] n Upper bound, exclusive, positive
+//! \return Random integer, uniformly distributed
+// *****************************************************************************
+{
+  return std::uniform_int_distribution< std::size_t >( 0, n - 1 )( m_gen );
+}
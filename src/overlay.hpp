@@ -0,0 +1,75 @@
+// *****************************************************************************
+/*!
+  \file      src/overlay.hpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac bounded-degree membership of the peer-to-peer overlay
+*/
+// *****************************************************************************
+
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace piac {
+
+//! Default number of peers, besides the one an event came from, forwarded to
+const std::size_t DEFAULT_FANOUT = 4;
+//! Maximum number of peers known but not connected to
+const std::size_t PASSIVE_VIEW = 32;
+//! Maximum number of addresses of peers sent in a list of peers
+const std::size_t PEER_SAMPLE = 8;
+//! Milliseconds between sending lists of peers to refresh passive views
+const long PEER_SHUFFLE_MS = 30000;
+//! Milliseconds to keep trying to tell a peer dropped that it was dropped
+const int PEER_DROP_LINGER_MS = 1000;
+
+//! Bounded-degree membership of the peer-to-peer overlay
+//! \details A simplified HyParView. Each peer is connected to an active view of
+//!   at most fanout + 1 peers, which it forwards announcements of changes to,
+//!   and knows a passive view of at most PASSIVE_VIEW peers, a random sample of
+//!   addresses learned from lists of peers, which are themselves bounded random
+//!   samples. Links of the active view are symmetric: a peer accepts one that
+//!   connects to it if it has room, or if the connecting peer has no other
+//!   peers, in which case it drops a random one to make room, and tells it so.
+//!   Peers dropped, dead or rejected are replaced by random passive peers.
+//!   Connections and messages per peer are thus bounded, independent of the
+//!   number of peers in the network.
+class Overlay {
+  public:
+    //! Constructor
+    explicit Overlay( std::size_t fanout = DEFAULT_FANOUT );
+
+    //! Maximum number of peers in the active view
+    std::size_t active() const { return m_fanout + 1; }
+
+    //! Remember address of peer in the passive view, unless already there
+    void learn( const std::string& addr );
+
+    //! Remove address of peer from the passive view
+    void forget( const std::string& addr );
+
+    //! Take a random address of peer from the passive view
+    bool pick( std::string& addr );
+
+    //! Random sample of addresses of peers active and passive to advertise
+    std::vector< std::string > sample( std::vector< std::string > active );
+
+    //! Random integer in [0,n)
+    std::size_t random( std::size_t n );
+
+    //! Number of peers in the passive view
+    std::size_t passive() const { return m_passive.size(); }
+
+  private:
+    //! Number of peers to forward to
+    std::size_t m_fanout;
+    //! Addresses of peers known but not connected to
+    std::vector< std::string > m_passive;
+    //! Random number generator
+    std::mt19937_64 m_gen;
+};
+
+} // piac::
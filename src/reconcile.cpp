@@ -0,0 +1,180 @@
+// *****************************************************************************
+/*!
+  \file      src/reconcile.cpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac range-based reconciliation of sets of hashes among peers
+*/
+// *****************************************************************************
+
+#include <algorithm>
+
+#include "reconcile.hpp"
+
+using piac::Reconciler;
+
+void
+Reconciler::assign( const HashSet& hashes )
+// *****************************************************************************
+//  Take a sorted snapshot of hashes to reconcile
+//! \param[in] hashes Set of hashes to take snapshot of
+// *****************************************************************************
+{
+  m_sorted.assign( hashes.begin(), hashes.end() );
+  std::sort( m_sorted.begin(), m_sorted.end() );
+  m_prefix.resize( m_sorted.size() + 1 );
+  m_prefix[0] = Hash256();
+  for (std::size_t i = 0; i < m_sorted.size(); ++i) {
+    m_prefix[i+1] = m_prefix[i];
+    m_prefix[i+1] ^= m_sorted[i];
+  }
+  m_stale = false;
+}
+
+piac::Hash256
+Reconciler::fingerprint( std::size_t first, std::size_t last ) const
+// *****************************************************************************
+//  Fingerprint of hashes in a range of the snapshot
+//! \param[in] first Index of first hash in range
+//! \param[in] last Index of one past the last hash in range
+//! \return Exclusive or of all hashes in range
+// *****************************************************************************
+{
+  auto f = m_prefix[ last ];
+  f ^= m_prefix[ first ];
+  return f;
+}
+
+void
+Reconciler::split( std::size_t first,
+                   std::size_t last,
+                   const Range& bound,
+                   std::vector< Range >& out ) const
+// *****************************************************************************
+//  Append ranges covering hashes in a range of the snapshot
+//! \param[in] first Index of first hash in range
+//! \param[in] last Index of one past the last hash in range
+//! \param[in] bound Range whose upper bound to end the last range at
+//! \param[in,out] out Ranges appended to
+//! \details A small range is sent as a list of its hashes, a large range is
+//!   split into RECON_BRANCH ranges of about equal number of hashes, each sent
+//!   as a fingerprint.
+// *****************************************************************************
+{
+  auto n = last - first;
+  if (n <= RECON_LIST_MAX) {
+    Range r;
+    r.mode = Range::LIST;
+    r.end = bound.end;
+    r.upper = bound.upper;
+    r.hashes.assign( m_sorted.begin() + static_cast< long >( first ),
+                     m_sorted.begin() + static_cast< long >( last ) );
+    out.push_back( std::move(r) );
+    return;
+  }
+
+  for (std::size_t k = 0; k < RECON_BRANCH; ++k) {
+    auto b = first + n * k / RECON_BRANCH;
+    auto e = first + n * (k + 1) / RECON_BRANCH;
+    Range r;
+    r.mode = Range::FINGERPRINT;
+    if (k + 1 < RECON_BRANCH) {
+      r.end = false;
+      r.upper = m_sorted[ e ];
+    } else {
+      r.end = bound.end;
+      r.upper = bound.upper;
+    }
+    r.count = e - b;
+    r.fingerprint = fingerprint( b, e );
+    out.push_back( std::move(r) );
+  }
+}
+
+std::vector< Reconciler::Range >
+Reconciler::initiate() const
+// *****************************************************************************
+//  Start reconciliation
+//! \return Ranges covering the whole hash space
+// *****************************************************************************
+{
+  std::vector< Range > out;
+  split( 0, m_sorted.size(), Range(), out );
+  return out;
+}
+
+std::vector< Reconciler::Range >
+Reconciler::respond( const std::vector< Range >& in,
+                     std::vector< Hash256 >& missing ) const
+// *****************************************************************************
+//  Answer ranges received from a peer
+//! \param[in] in Ranges received, covering the hash space from its beginning
+//! \param[in,out] missing Hashes the peer has but this snapshot lacks
+//!   appended to
+//! \return Ranges to send back, empty if there is nothing left to reconcile
+// *****************************************************************************
+{
+  std::vector< Range > out;
+  bool done = true;
+
+  // append range in sync, merging with previous if also in sync
+  auto skip = [&]( const Range& r ){
+    if (out.empty() || out.back().mode != Range::SKIP) out.emplace_back();
+    out.back().end = r.end;
+    out.back().upper = r.upper;
+  };
+
+  std::size_t first = 0;
+  for (const auto& r : in) {
+    auto last = r.end ? m_sorted.size() :
+      static_cast< std::size_t >( std::lower_bound( m_sorted.begin(),
+        m_sorted.end(), r.upper ) - m_sorted.begin() );
+    last = std::max( first, last );
+
+    if (r.mode == Range::FINGERPRINT) {
+
+      if (r.count == last - first && r.fingerprint == fingerprint(first,last)) {
+        skip( r );
+      } else {
+        split( first, last, r, out );
+        done = false;
+      }
+
+    } else if (r.mode == Range::LIST) {
+
+      // hashes the peer has that we lack
+      std::vector< Hash256 > theirs( r.hashes );
+      std::sort( theirs.begin(), theirs.end() );
+      auto b = m_sorted.begin() + static_cast< long >( first );
+      auto e = m_sorted.begin() + static_cast< long >( last );
+      std::set_difference( theirs.begin(), theirs.end(), b, e,
+                           std::back_inserter( missing ) );
+      // hashes we have that the peer lacks
+      Range n;
+      n.mode = Range::NEED;
+      n.end = r.end;
+      n.upper = r.upper;
+      std::set_difference( b, e, theirs.begin(), theirs.end(),
+                           std::back_inserter( n.hashes ) );
+      if (n.hashes.empty()) {
+        skip( r );
+      } else {
+        out.push_back( std::move(n) );
+        done = false;
+      }
+
+    } else {
+
+      if (r.mode == Range::NEED)
+        missing.insert( missing.end(), r.hashes.begin(), r.hashes.end() );
+      skip( r );
+
+    }
+
+    if (r.end) break;
+    first = last;
+  }
+
+  if (done) out.clear();
+  return out;
+}
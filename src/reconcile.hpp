@@ -0,0 +1,97 @@
+// *****************************************************************************
+/*!
+  \file      src/reconcile.hpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac range-based reconciliation of sets of hashes among peers
+*/
+// *****************************************************************************
+
+#pragma once
+
+#include "hash256.hpp"
+
+namespace piac {
+
+//! Maximum number of hashes in a range sent as a list instead of split
+const std::size_t RECON_LIST_MAX = 32;
+//! Number of subranges a range whose fingerprints differ is split into
+const std::size_t RECON_BRANCH = 16;
+
+//! Range-based reconciliation of sets of hashes among peers
+//! \details Instead of sending all of its hashes, a peer sends fingerprints
+//!   of a few ranges covering the sorted hash space, each fingerprint being
+//!   the exclusive or of all hashes in the range and their count. The other
+//!   peer compares them to its own: ranges that match are in sync, ranges
+//!   that differ are split into subranges and their fingerprints sent back,
+//!   until ranges become small enough to exchange their hashes as lists.
+//!   Differences are thus found in a number of rounds logarithmic in the
+//!   number of hashes, exchanging data proportional to the number of
+//!   differences. Fingerprints are computed in constant time from prefix
+//!   sums (prefix exclusive ors) of the sorted hashes. The fingerprint is not
+//!   collision resistant against crafted sets of hashes, which could hide
+//!   documents of the peer crafting them, but not those of others.
+class Reconciler {
+  public:
+    //! Range of the hash space in a reconciliation message
+    //! \details The lower bound of a range is the upper bound of the previous
+    //!   range in the message, the first range starting at the beginning of
+    //!   the hash space.
+    struct Range {
+      //! What the range carries
+      enum Mode : char {
+        FINGERPRINT = 'F',      //!< Number and fingerprint of sender's hashes
+        LIST = 'L',             //!< All of the sender's hashes in the range
+        NEED = 'N',             //!< Hashes the receiver lacks, final
+        SKIP = 'S'              //!< Nothing, range is in sync
+      };
+      //! What the range carries
+      Mode mode = SKIP;
+      //! True if the range extends to the end of the hash space
+      bool end = true;
+      //! Exclusive upper bound of range unless end is true
+      Hash256 upper;
+      //! Number of sender's hashes in range (FINGERPRINT)
+      std::size_t count = 0;
+      //! Fingerprint of sender's hashes in range (FINGERPRINT)
+      Hash256 fingerprint;
+      //! Hashes (LIST, NEED)
+      std::vector< Hash256 > hashes;
+    };
+
+    //! Take a sorted snapshot of hashes to reconcile
+    void assign( const HashSet& hashes );
+
+    //! Mark snapshot out of date, e.g., after hashes changed
+    void invalidate() { m_stale = true; }
+
+    //! Take a new snapshot only if marked out of date
+    void refresh( const HashSet& hashes ) { if (m_stale) assign( hashes ); }
+
+    //! Number of hashes in snapshot
+    std::size_t size() const { return m_sorted.size(); }
+
+    //! Start reconciliation: ranges covering all hashes
+    std::vector< Range > initiate() const;
+
+    //! Answer ranges received from a peer
+    std::vector< Range > respond( const std::vector< Range >& in,
+                                  std::vector< Hash256 >& missing ) const;
+
+  private:
+    //! Fingerprint of hashes in [first,last) of snapshot
+    Hash256 fingerprint( std::size_t first, std::size_t last ) const;
+
+    //! Append ranges covering hashes [first,last) of snapshot
+    void split( std::size_t first, std::size_t last, const Range& bound,
+                std::vector< Range >& out ) const;
+
+    //! Hashes in snapshot, sorted
+    std::vector< Hash256 > m_sorted;
+    //! Exclusive or of the first i hashes of the snapshot at i
+    std::vector< Hash256 > m_prefix;
+    //! True if the snapshot is out of date
+    bool m_stale = true;
+};
+
+} // piac::
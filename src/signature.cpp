@@ -0,0 +1,103 @@
+// *****************************************************************************
+/*!
+  \file      src/signature.cpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac signatures of messages by monero wallets
+*/
+// *****************************************************************************
+
+#include "macro.hpp"
+
+#if defined(__clang__)
+  #pragma clang diagnostic push
+  #pragma clang diagnostic ignored "-Wdeprecated-copy-dtor"
+  #pragma clang diagnostic ignored "-Wnon-virtual-dtor"
+  #pragma clang diagnostic ignored "-Wunused-template"
+  #pragma clang diagnostic ignored "-Wsign-conversion"
+  #pragma clang diagnostic ignored "-Wcast-qual"
+  #pragma clang diagnostic ignored "-Wshadow"
+  #pragma clang diagnostic ignored "-Wextra-semi"
+  #pragma clang diagnostic ignored "-Wextra-semi-stmt"
+  #pragma clang diagnostic ignored "-Wdocumentation"
+  #pragma clang diagnostic ignored "-Wunused-parameter"
+  #pragma clang diagnostic ignored "-Wdocumentation-unknown-command"
+  #pragma clang diagnostic ignored "-Wreserved-id-macro"
+  #pragma clang diagnostic ignored "-Wc++98-compat-pedantic"
+  #pragma clang diagnostic ignored "-Wzero-as-null-pointer-constant"
+  #pragma clang diagnostic ignored "-Wimplicit-int-conversion"
+  #pragma clang diagnostic ignored "-Wold-style-cast"
+  #pragma clang diagnostic ignored "-Wshorten-64-to-32"
+  #pragma clang diagnostic ignored "-Wdisabled-macro-expansion"
+  #pragma clang diagnostic ignored "-Wredundant-parens"
+  #pragma clang diagnostic ignored "-Wweak-vtables"
+  #pragma clang diagnostic ignored "-Wgnu-anonymous-struct"
+  #pragma clang diagnostic ignored "-Wgnu-zero-variadic-macro-arguments"
+#elif defined(STRICT_GNUC)
+  #pragma GCC diagnostic push
+  #pragma GCC diagnostic ignored "-Wunused-parameter"
+#endif
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "string_tools.h"
+
+#if defined(__clang__)
+  #pragma clang diagnostic pop
+#elif defined(STRICT_GNUC)
+  #pragma GCC diagnostic pop
+#endif
+
+#include "signature.hpp"
+
+std::string
+piac::sign_message( const std::string& secret_spend_key,
+                    const std::string& public_spend_key,
+                    const std::string& msg )
+// *****************************************************************************
+//  Sign a message with the spend key of a monero wallet
+//! \param[in] secret_spend_key Hex-encoded private spend key of wallet
+//! \param[in] public_spend_key Hex-encoded public spend key of wallet
+//! \param[in] msg Message to sign
+//! \return Hex-encoded signature of the hash of the message, empty if the keys
+//!   are invalid
+// *****************************************************************************
+{
+  crypto::secret_key sec;
+  crypto::public_key pub;
+  if (not epee::string_tools::hex_to_pod( secret_spend_key, sec ) ||
+      not epee::string_tools::hex_to_pod( public_spend_key, pub ))
+  {
+    return {};
+  }
+  auto hash = crypto::cn_fast_hash( msg.data(), msg.size() );
+  crypto::signature sig;
+  crypto::generate_signature( hash, pub, sec, sig );
+  return epee::string_tools::pod_to_hex( sig );
+}
+
+bool
+piac::verify_message( const std::string& address,
+                      const std::string& msg,
+                      const std::string& signature )
+// *****************************************************************************
+//  Verify signature of a message by the owner of a monero address
+//! \param[in] address Primary address of wallet that signed the message
+//! \param[in] msg Message signed
+//! \param[in] signature Hex-encoded signature of the hash of the message
+//! \return True if the message was signed with the spend key of the address
+//! \details Addresses are of wallets on stagenet, which users create.
+// *****************************************************************************
+{
+  cryptonote::address_parse_info info;
+  if (not cryptonote::get_account_address_from_str( info, cryptonote::STAGENET,
+                                                    address ))
+  {
+    return false;
+  }
+  crypto::signature sig;
+  if (not epee::string_tools::hex_to_pod( signature, sig )) return false;
+  auto hash = crypto::cn_fast_hash( msg.data(), msg.size() );
+  return crypto::check_signature( hash, info.address.m_spend_public_key, sig );
+}
@@ -0,0 +1,26 @@
+// *****************************************************************************
+/*!
+  \file      src/signature.hpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac signatures of messages by monero wallets
+*/
+// *****************************************************************************
+
+#pragma once
+
+#include <string>
+
+namespace piac {
+
+//! Sign a message with the spend key of a monero wallet
+std::string sign_message( const std::string& secret_spend_key,
+                          const std::string& public_spend_key,
+                          const std::string& msg );
+
+//! Verify signature of a message by the owner of a monero address
+bool verify_message( const std::string& address,
+                     const std::string& msg,
+                     const std::string& signature );
+
+} // ::piac
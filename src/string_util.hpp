@@ -18,6 +18,7 @@
 #include <string>
 #include <vector>
 #include <utility>
+#include <charconv>
 
 #if defined(__clang__)
   #pragma clang diagnostic pop
@@ -40,4 +41,16 @@ wordcount( const std::string& s );
 [[nodiscard]] std::pair< std::string, std::string >
 split( std::string s, const std::string& delim );
 
+//! Parse a decimal number taking up all of a string, e.g., received from a peer
+//! \param[in] s String to parse
+//! \param[out] n Number parsed, unchanged if the string is not a number
+//! \return True if the string is a number that fits in n
+template< typename T >
+[[nodiscard]] bool
+to_number( const std::string& s, T& n ) {
+  auto e = s.data() + s.size();
+  auto [p, ec] = std::from_chars( s.data(), e, n );
+  return ec == std::errc() && p == e;
+}
+
 } // ::piac
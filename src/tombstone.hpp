@@ -0,0 +1,48 @@
+// *****************************************************************************
+/*!
+  \file      src/tombstone.hpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac records of documents deleted by their authors
+*/
+// *****************************************************************************
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace piac {
+
+//! Default number of seconds tombstones are kept for
+const double DEFAULT_TOMBSTONE_HORIZON = 30 * 24 * 60 * 60;
+//! Number of seconds a tombstone may be dated ahead of the clock of a peer
+const std::int64_t TOMBSTONE_MAX_SKEW = 10 * 60;
+
+//! Record of a document deleted by its author
+//! \details Tombstones are gossiped among peers so that a document deleted by
+//!   its author is deleted by every peer and not synced back from peers that
+//!   still have it. A tombstone is bound to the author of the document: a peer
+//!   only deletes a document, or refuses to insert one, if its author matches
+//!   the tombstone's. The author signs the hash and time of deletion with the
+//!   spend key of their wallet, whose primary address the author is the hash
+//!   of, so a tombstone is only accepted if signed by the author. Tombstones
+//!   are kept until their horizon, after which a document still held by a peer
+//!   that missed the deletion may sync back.
+struct Tombstone {
+  //! Hash of document deleted
+  std::string hash;
+  //! Author of document deleted
+  std::string author;
+  //! Time the document was deleted, seconds since the epoch
+  std::int64_t time = 0;
+  //! Primary address of the wallet of the author
+  std::string address;
+  //! Hex-encoded signature of message() by the author
+  std::string signature;
+
+  //! Message signed by the author: hash and time of deletion
+  std::string message() const { return hash + std::to_string( time ); }
+};
+
+} // piac::
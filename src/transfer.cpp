@@ -0,0 +1,94 @@
+// *****************************************************************************
+/*!
+  \file      src/transfer.cpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac flow-controlled transfer of documents from a peer
+*/
+// *****************************************************************************
+
+#include <algorithm>
+
+#include "transfer.hpp"
+
+using piac::Transfer;
+
+void
+Transfer::want( const Hash256& hash )
+// *****************************************************************************
+//  Queue hash to request, unless already queued or in flight
+//! \param[in] hash Hash of document to request
+// *****************************************************************************
+{
+  if (m_wanted.contains( hash )) return;
+  m_wanted.insert( hash );
+  m_queue.push_back( hash );
+}
+
+bool
+Transfer::next( Chunk& chunk, clock::time_point now )
+// *****************************************************************************
+//  Take the next chunk of hashes to request if a credit is available
+//! \param[out] chunk Id of request and hashes to request
+//! \param[in] now Time the request is sent
+//! \return True if there is a chunk to request, false if none or no credit
+// *****************************************************************************
+{
+  if (not ready()) return false;
+
+  auto n = std::min( m_queue.size(), TRANSFER_CHUNK_HASHES );
+  chunk.id = m_next++;
+  chunk.hashes.assign( m_queue.begin(),
+                       m_queue.begin() + static_cast< long >( n ) );
+  m_queue.erase( m_queue.begin(), m_queue.begin() + static_cast< long >( n ) );
+  m_inflight[ chunk.id ] = { chunk.hashes, now };
+  return true;
+}
+
+bool
+Transfer::received( std::uint64_t id, std::size_t served )
+// *****************************************************************************
+//  Account for a reply to a request, queue again hashes not looked up
+//! \param[in] id Id of request replied to
+//! \param[in] served Number of hashes, in order, the peer looked up
+//! \return False if the request is not in flight, e.g., already expired
+//! \details Hashes looked up are no longer wanted: they either arrived with the
+//!   reply or the peer does not have them. The rest are queued again in front,
+//!   so they are requested next.
+// *****************************************************************************
+{
+  auto r = m_inflight.find( id );
+  if (r == end(m_inflight)) return false;
+
+  const auto& hashes = r->second.hashes;
+  served = std::min( served, hashes.size() );
+  for (std::size_t i = 0; i < served; ++i) m_wanted.erase( hashes[i] );
+  m_queue.insert( m_queue.begin(),
+                  hashes.begin() + static_cast< long >( served ),
+                  hashes.end() );
+  m_inflight.erase( r );
+  return true;
+}
+
+std::size_t
+Transfer::expire( clock::time_point now )
+// *****************************************************************************
+//  Queue again hashes of requests not replied to in time
+//! \param[in] now Current time
+//! \return Number of requests expired
+// *****************************************************************************
+{
+  std::size_t expired = 0;
+  auto timeout = std::chrono::milliseconds( TRANSFER_TIMEOUT_MS );
+  for (auto r = m_inflight.begin(); r != m_inflight.end(); ) {
+    if (now - r->second.sent >= timeout) {
+      m_queue.insert( m_queue.begin(), r->second.hashes.begin(),
+                      r->second.hashes.end() );
+      r = m_inflight.erase( r );
+      ++expired;
+    } else {
+      ++r;
+    }
+  }
+  return expired;
+}
@@ -0,0 +1,98 @@
+// *****************************************************************************
+/*!
+  \file      src/transfer.hpp
+  \copyright 2022-2025 J. Bakosi,
+             All rights reserved. See the LICENSE file for details.
+  \brief     Piac flow-controlled transfer of documents from a peer
+*/
+// *****************************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <map>
+
+#include "hash256.hpp"
+
+namespace piac {
+
+//! Maximum number of hashes requested from a peer in a single request
+const std::size_t TRANSFER_CHUNK_HASHES = 256;
+//! Maximum number of bytes of documents a peer sends in reply to a request
+const std::size_t TRANSFER_CHUNK_BYTES = 1 << 20;
+//! Maximum number of requests in flight to a peer
+const std::size_t TRANSFER_CREDITS = 4;
+//! Milliseconds to wait for a reply before requesting its documents again
+const long TRANSFER_TIMEOUT_MS = 10000;
+
+//! Documents to request from a peer in chunks, with flow control
+//! \details Hashes of documents wanted from a peer are queued and requested in
+//!   chunks of at most TRANSFER_CHUNK_HASHES hashes, each request granting the
+//!   peer TRANSFER_CHUNK_BYTES bytes to reply with. At most TRANSFER_CREDITS
+//!   requests are in flight at a time, a reply returning a credit, so the bytes
+//!   in flight from a peer are bounded, independent of the number of documents
+//!   wanted. The peer replies with the number of hashes it looked up: those it
+//!   did not get to within the bytes granted are queued again. Requests not
+//!   replied to in time, e.g., because the peer disconnected, are queued again
+//!   as well, so the transfer resumes where it left off once the peer is back.
+class Transfer {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    //! Chunk of hashes requested in a single request
+    struct Chunk {
+      //! Id of request, echoed back by the peer in its reply
+      std::uint64_t id = 0;
+      //! Hashes requested
+      std::vector< Hash256 > hashes;
+    };
+
+    //! Queue hash to request, unless already queued or in flight
+    void want( const Hash256& hash );
+
+    //! Take the next chunk of hashes to request if a credit is available
+    bool next( Chunk& chunk, clock::time_point now = clock::now() );
+
+    //! Account for a reply to a request, queue again hashes not looked up
+    bool received( std::uint64_t id, std::size_t served );
+
+    //! Queue again hashes of requests not replied to in time
+    std::size_t expire( clock::time_point now = clock::now() );
+
+    //! True if there are hashes to request and a credit available
+    bool ready() const {
+      return not m_queue.empty() && m_inflight.size() < TRANSFER_CREDITS;
+    }
+
+    //! True if hash is queued or in flight
+    bool wants( const Hash256& hash ) const {
+      return m_wanted.contains( hash );
+    }
+
+    //! Number of hashes queued or in flight
+    std::size_t size() const { return m_wanted.size(); }
+
+    //! Number of requests in flight
+    std::size_t inflight() const { return m_inflight.size(); }
+
+  private:
+    //! Request in flight
+    struct Request {
+      //! Hashes requested
+      std::vector< Hash256 > hashes;
+      //! When the request was sent
+      clock::time_point sent;
+    };
+
+    //! Hashes to request, in order
+    std::deque< Hash256 > m_queue;
+    //! Hashes queued or in flight
+    HashSet m_wanted;
+    //! Requests in flight associated to their ids
+    std::map< std::uint64_t, Request > m_inflight;
+    //! Id of next request
+    std::uint64_t m_next = 1;
+};
+
+} // piac::
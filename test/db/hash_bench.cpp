@@ -0,0 +1,68 @@
+// Microbenchmark: cost of hashing documents one call and hash object at a time
+// versus hashing them in a batch with a single hash object
+
+#include <chrono>
+#include <random>
+#include <iostream>
+
+#include <cryptopp/sha.h>
+
+#include "crypto_util.hpp"
+
+// Hash a string the way it was done before hashing in batches
+static std::string
+sha256_percall( const std::string& msg )
+{
+  using namespace CryptoPP;
+  std::string digest;
+  SHA256 hash;
+  hash.Update( reinterpret_cast< const byte* >( msg.data() ), msg.size() );
+  digest.resize( hash.DigestSize() );
+  hash.Final( reinterpret_cast< byte* >( &digest[0] ) );
+  return digest;
+}
+
+int main( int argc, char** argv ) {
+
+  std::size_t numdoc = argc > 1 ? std::stoul( argv[1] ) : 100000;
+  std::size_t docsize = argc > 2 ? std::stoul( argv[2] ) : 512;
+  std::size_t rounds = argc > 3 ? std::stoul( argv[3] ) : 5;
+
+  std::mt19937 gen( 1234 );
+  std::uniform_int_distribution< int > dist( 32, 126 );
+  std::vector< std::string > docs( numdoc );
+  for (auto& d : docs) {
+    d.resize( docsize );
+    for (auto& c : d) c = static_cast< char >( dist(gen) );
+  }
+
+  using clock = std::chrono::high_resolution_clock;
+  std::chrono::duration< double, std::micro > percall{}, batch{};
+  std::size_t mismatch = 0;
+
+  for (std::size_t r = 0; r < rounds; ++r) {
+    auto start = clock::now();
+    std::vector< std::string > a;
+    a.reserve( docs.size() );
+    for (const auto& d : docs) a.push_back( sha256_percall( d ) );
+    percall += clock::now() - start;
+
+    start = clock::now();
+    auto b = piac::sha256_batch( docs );
+    batch += clock::now() - start;
+
+    for (std::size_t i = 0; i < docs.size(); ++i)
+      if (b[i].str() != a[i]) ++mismatch;
+  }
+
+  CryptoPP::SHA256 hash;
+  auto n = static_cast< double >( numdoc * rounds );
+  std::cout << "Documents: " << numdoc << ", bytes/doc: " << docsize
+            << ", rounds: " << rounds << ", provider: "
+            << hash.AlgorithmProvider() << '\n'
+            << "Per call: " << percall.count() / n << " us/doc\n"
+            << "Batched:  " << batch.count() / n << " us/doc\n"
+            << "Speedup: " << percall.count() / batch.count() << "x\n";
+
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,95 @@
+// Microbenchmark: per-query cost of reopening the Xapian database, query parser
+// and stemmer on every call versus reusing long-lived handles
+
+#include <chrono>
+#include <filesystem>
+#include <random>
+
+#include "logging_util.hpp"
+#include "db.hpp"
+
+static const std::vector< std::string > g_words{
+  "laptop", "wallet", "hardware", "monero", "bookcase", "furniture", "phone",
+  "camera", "bicycle", "guitar", "lamp", "desk", "chair", "keyboard", "mouse",
+  "monitor", "printer", "jacket", "boots", "watch", "ring", "book", "table" };
+
+static std::string
+sentence( std::mt19937& gen, std::size_t n )
+{
+  std::uniform_int_distribution< std::size_t > dist( 0, g_words.size()-1 );
+  std::string s;
+  for (std::size_t i=0; i<n; ++i) s += g_words[ dist(gen) ] + ' ';
+  return s;
+}
+
+// Query the database the way it was done before handles were kept alive
+static std::size_t
+reopen_query( const std::string& db_name, const std::string& q )
+{
+  Xapian::Database db( db_name );
+  Xapian::Enquire enquire( db );
+  Xapian::QueryParser qp;
+  Xapian::Stem stemmer( "english" );
+  qp.set_stemmer( stemmer );
+  qp.set_database( db );
+  qp.set_stemming_strategy( Xapian::QueryParser::STEM_SOME );
+  enquire.set_query( qp.parse_query( q ) );
+  auto matches = enquire.get_mset( 0, 10 );
+  std::size_t size = 0;
+  for (auto i = matches.begin(); i != matches.end(); ++i)
+    size += i.get_document().get_data().size();
+  return size;
+}
+
+int main( int argc, char** argv ) {
+
+  std::size_t numdoc = argc > 1 ? std::stoul( argv[1] ) : 10000;
+  std::size_t numquery = argc > 2 ? std::stoul( argv[2] ) : 2000;
+
+  piac::setup_logging( "query_bench.log", "0", /* console_logging = */ false,
+                       MAX_LOG_FILE_SIZE, MAX_LOG_FILES );
+
+  std::string db_name( "query_bench.db" );
+  std::filesystem::remove_all( db_name );
+
+  std::mt19937 gen( 1234 );
+  piac::Database db( db_name );
+  for (std::size_t i=0; i<numdoc; ++i) {
+    piac::Document d;
+    d.id( static_cast< int >( i ) );
+    d.title( sentence( gen, 4 ) );
+    d.description( sentence( gen, 20 ) );
+    d.price( static_cast< double >( i % 100 ) );
+    d.category( sentence( gen, 1 ) );
+    d.condition( "new" );
+    d.shipping( "pickup" );
+    d.format( "buy it now" );
+    d.location( "home" );
+    d.keywords( sentence( gen, 3 ) );
+    piac::add_document( "bench", db.schema(), db.indexer(), db.writer(), d );
+  }
+  db.commit();
+
+  std::vector< std::string > queries;
+  for (std::size_t i=0; i<numquery; ++i) queries.push_back( sentence( gen, 2 ) );
+
+  using clock = std::chrono::high_resolution_clock;
+  std::size_t hits = 0;
+
+  auto start = clock::now();
+  for (const auto& q : queries) hits += reopen_query( db_name, q );
+  std::chrono::duration< double, std::micro > reopen = clock::now() - start;
+
+  start = clock::now();
+  for (auto q : queries) hits += piac::db_query( db, std::move(q) ).size();
+  std::chrono::duration< double, std::micro > reuse = clock::now() - start;
+
+  auto n = static_cast< double >( numquery );
+  std::cout << "Documents: " << numdoc << ", queries: " << numquery << '\n'
+            << "Reopen per query: " << reopen.count() / n << " us/query\n"
+            << "Reuse handles:    " << reuse.count() / n << " us/query\n"
+            << "Speedup: " << reopen.count() / reuse.count() << "x\n";
+
+  std::filesystem::remove_all( db_name );
+  return hits > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
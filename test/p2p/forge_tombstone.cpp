@@ -0,0 +1,52 @@
+// Send a peer a tombstone of a document not signed by its author
+
+#if defined(__clang__)
+  #pragma clang diagnostic push
+  #pragma clang diagnostic ignored "-Wundef"
+  #pragma clang diagnostic ignored "-Wpadded"
+  #pragma clang diagnostic ignored "-Wdocumentation-unknown-command"
+  #pragma clang diagnostic ignored "-Wc++98-compat-pedantic"
+  #pragma clang diagnostic ignored "-Wdocumentation-deprecated-sync"
+  #pragma clang diagnostic ignored "-Wdocumentation"
+  #pragma clang diagnostic ignored "-Wweak-vtables"
+#endif
+
+#include <zmqpp/zmqpp.hpp>
+
+#if defined(__clang__)
+  #pragma clang diagnostic pop
+#endif
+
+#include <ctime>
+#include <iostream>
+
+#include "crypto_util.hpp"
+
+int main( int argc, char** argv ) {
+
+  if (argc != 4) {
+    std::cout << "Usage: " << argv[0] << " <p2p port> <hex hash> <address>\n";
+    return EXIT_FAILURE;
+  }
+
+  std::string port( argv[1] ), hash( argv[2] ), address( argv[3] );
+
+  zmqpp::context ctx;
+  zmqpp::socket peer( ctx, zmqpp::socket_type::dealer );
+  peer.set( zmqpp::socket_option::linger, 1000 );
+  peer.connect( "tcp://localhost:" + port );
+
+  // claim the author of the document deleted it, but sign with a wrong key
+  zmqpp::message msg;
+  msg << "TOMB" << "localhost:1" << "1"
+      << piac::unhex( hash )
+      << piac::sha256( address )
+      << std::to_string( std::time( nullptr ) )
+      << address
+      << std::string( 128, '1' );
+  peer.send( msg );
+
+  std::cout << "Sent forged tombstone of " << hash << " to localhost:" << port
+            << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -24,8 +24,9 @@ using namespace std;
 
 int main( int argc, char** argv ) {
 
-  if (argc != 2) {
-     cout << "Usage: " << argv[0] << " <path-to-txt-files>\n";
+  if (argc < 2 || argc > 4 || (argc == 4 && string( argv[3] ) != "compact")) {
+     cout << "Usage: " << argv[0]
+          << " <path-to-txt-files> [<num-entries> [compact]]\n";
      return EXIT_FAILURE;
   }
 
@@ -80,52 +81,92 @@ int main( int argc, char** argv ) {
   }
   _noun.close();
 
-  auto lastname = adverb[randBetween(0,adverb.size()-1)];
-  lastname[0] = static_cast< char >( toupper( lastname[0] ) );
-
-  auto thing = [&](){ return noun[randBetween(0,noun.size()-1)]; };
-  auto adj = [&](){ return adjective[randBetween(0,adjective.size()-1)]; };
-
-  auto keyword = [&]( int num ){
-    std::string k;
-    for (int i=0; i<num; ++i) k += thing() + ';';
-    k.pop_back();
-    return k;
+  auto entry = [&]( bool compact ){
+
+    auto lastname = adverb[randBetween(0,adverb.size()-1)];
+    lastname[0] = static_cast< char >( toupper( lastname[0] ) );
+
+    auto thing = [&](){ return noun[randBetween(0,noun.size()-1)]; };
+    auto adj = [&](){ return adjective[randBetween(0,adjective.size()-1)]; };
+
+    auto keyword = [&]( int num ){
+      std::string k;
+      for (int i=0; i<num; ++i) k += thing() + ';';
+      k.pop_back();
+      return k;
+    };
+
+    auto product = adj();
+    product[0] = static_cast< char >( toupper( product[0] ) );
+    product += ' ' + thing();
+
+    auto sentence = [&]( int num ){
+      std::string d;
+      for (int i=0; i<num; ++i)
+        d += pronoun[randBetween(0,pronoun.size()-1)] + ' '
+           + adverb[randBetween(0,adverb.size()-1)] + ' '
+           + verb[randBetween(0,verb.size()-1)] + ' '
+           + preposition[randBetween(0,preposition.size()-1)] + " the "
+           + adjective[randBetween(0,adjective.size()-1)] + ' '
+           + noun[randBetween(0,noun.size()-1)] + ". ";
+       d.pop_back();
+       return d;
+    };
+
+    auto title = product;
+    auto author = pronoun[randBetween(0,pronoun.size()-1)]+' '+lastname;
+    auto description = sentence(10);
+    auto category = thing();
+    auto price = std::to_string( randDoubleBetween( 0.0, 11.0 ) );
+    auto condition = adj();
+    auto keywords = keyword(4);
+    auto id = std::to_string( randBetween(0, RAND_MAX) );
+
+    // one line, keys in the order documents are serialized to send to peers
+    if (compact) {
+      return R"({"id":)" + id + R"(,"title":")" + title + R"(","author":")" +
+        author + R"(","description":")" + description + R"(","price":)" +
+        price + R"(,"category":")" + category + R"(","condition":")" +
+        condition + R"(","shipping":"pickup, delivery, convert to array",)"
+        R"("format":"buy it now","location":"home","keywords":")" + keywords +
+        R"("})";
+    }
+
+    string json_entry( R"(
+  {
+    "author": ")" + author + R"(",
+    "title": ")" + title + R"(",
+    "description": ")" + description + R"(",
+    "category": ")" + category + R"(",
+    "price": )" + price + R"(,
+    "condition": ")" + condition + R"(",
+    "shipping": "pickup, delivery, convert to array",
+    "format": "buy it now",
+    "location": "home",
+    "keywords": ")" + keywords + R"(",
+    "id": )" + id + R"(
+  })" );
+
+    return json_entry;
   };
 
-  auto product = adj();
-  product[0] = static_cast< char >( toupper( product[0] ) );
-  product += ' ' + thing();
-
-  auto sentence = [&]( int num ){
-    std::string d;
-    for (int i=0; i<num; ++i)
-      d += pronoun[randBetween(0,pronoun.size()-1)] + ' '
-         + adverb[randBetween(0,adverb.size()-1)] + ' '
-         + verb[randBetween(0,verb.size()-1)] + ' '
-         + preposition[randBetween(0,preposition.size()-1)] + " the "
-         + adjective[randBetween(0,adjective.size()-1)] + ' '
-         + noun[randBetween(0,noun.size()-1)] + ". ";
-     d.pop_back();
-     return d;
-  };
+  if (argc == 2) {
+    cout << entry( false ) << '\n';
+    return 0;
+  }
+
+  // entries one per line, e.g., as samples to train a compression dictionary
+  auto num = stoul( argv[2] );
+  if (argc == 4) {
+    for (std::size_t i = 0; i < num; ++i) cout << entry( true ) << '\n';
+    return 0;
+  }
 
-  string json_entry( R"(
-{
-  "author": ")" + pronoun[randBetween(0,pronoun.size()-1)]+' '+lastname + R"(",
-  "title": ")" + product + R"(",
-  "description": ")" + sentence(10) + R"(",
-  "category": ")" + thing() + R"(",
-  "price": )" + std::to_string( randDoubleBetween( 0.0, 11.0 ) ) + R"(,
-  "condition": ")" + adj() + R"(",
-  "shipping": "pickup, delivery, convert to array",
-  "format": "buy it now",
-  "location": "home",
-  "keywords": ")" + keyword(4) + R"(",
-  "id": )" + std::to_string( randBetween(0, RAND_MAX) ) + R"(
-})" );
-
-  cout << json_entry << '\n';
+  // array of entries, e.g., to test bulk indexing
+  cout << '[';
+  for (std::size_t i = 0; i < num; ++i)
+    cout << (i ? "," : "") << entry( false );
+  cout << "\n]\n";
 
   return 0;
 }